@@ -6,6 +6,36 @@
 #include <glm/glm.hpp>
 
 constexpr const char* WINDOW_TITLE = "Example";
+constexpr uint64_t LATENCY_REPORT_FRAMES = 1000;
+constexpr uint32_t PROFILER_MAX_SCOPES = 16;
+constexpr uint64_t TRACE_CAPTURE_FRAMES = 60; // From startup, written to TRACE_PATH once done.
+constexpr const char* TRACE_PATH = "trace.json";
+constexpr poly::vk::present_policy PRESENT_POLICY = poly::vk::present_policy::throughput;
+
+#ifdef POLYMORPH_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts every C++ heap allocation, to check the steady state frame loop makes none.
+static std::atomic<uint64_t> allocation_count{ 0 };
+
+void* operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+constexpr uint32_t WARMUP_FRAMES = 100;   // Lets pools and queues grow to their steady state sizes.
+constexpr uint32_t COUNTED_FRAMES = 1000;
+#endif
 
 struct vertex
 {
@@ -15,6 +45,9 @@ struct vertex
 
 int main()
 {
+    poly::name_trace_thread("main");
+    poly::start_trace_capture();
+
     poly::window<int> window(800, 600, WINDOW_TITLE, 0);
 
     auto required_layers = std::vector<const char*> { "VK_LAYER_KHRONOS_validation" };
@@ -53,66 +86,128 @@ int main()
     poly::vk::create_command_buffer_set(context, cb_set, VK_COMMAND_BUFFER_LEVEL_PRIMARY, context.swapchain.max_frames_in_flight);
 
     poly::vk::draw_state_context dsc{ pipeline, sync, cb_set, context.swapchain.max_frames_in_flight };
+    if (PRESENT_POLICY != context.swapchain.policy)
+    {
+        poly::vk::set_present_policy(context, dsc, PRESENT_POLICY);
+    }
 
     std::vector<vertex> vertices = {
         {{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
         {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
         {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
     };
-    poly::vk::buffer vertex_buf;
-    poly::vk::create_staged_buffer(context, vertex_buf, sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.data());
-
     std::vector<uint16_t> indices = {
         0, 1, 2
     };
-    poly::vk::buffer index_buf;
-    poly::vk::create_staged_buffer(context, index_buf, sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data());
 
+    poly::vk::geometry_pool geometry;
+    poly::vk::create_geometry_pool(context, geometry, sizeof(vertex), 1 << 16, VK_INDEX_TYPE_UINT16, 1 << 18);
+
+    poly::vk::mesh_range triangle;
+    poly::vk::allocate_mesh(context, geometry, triangle, vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+
+    poly::vk::gpu_culling culling;
+    poly::vk::create_gpu_culling(context, culling, 1, "shader/cull.comp.spv");
+
+    auto object = poly::vk::make_gpu_object(triangle, glm::vec3(0.0f), 0.75f);
+    poly::vk::write_gpu_objects(context, culling, 0, 1, &object);
+
+    poly::vk::wait_for_upload(context, context.uploads, poly::vk::flush_uploads(context, context.uploads));
+
+    poly::vk::gpu_profiler profiler;
+    poly::vk::create_gpu_profiler(context, profiler, context.swapchain.max_frames_in_flight, PROFILER_MAX_SCOPES, true);
+    poly::vk::capture_gpu_trace(profiler, true);
+
+#ifdef POLYMORPH_COUNT_ALLOCATIONS
+    uint32_t frame_count = 0;
+    uint64_t allocations_before = 0;
+    int exit_code = 0;
+#endif
 
     window.start([&]()
         {
+#ifdef POLYMORPH_COUNT_ALLOCATIONS
+            if (frame_count == WARMUP_FRAMES)
+            {
+                allocations_before = allocation_count.load();
+            }
+            else if (frame_count == WARMUP_FRAMES + COUNTED_FRAMES)
+            {
+                uint64_t allocations = allocation_count.load() - allocations_before;
+                printf("%llu heap allocations over %u frames\n", static_cast<unsigned long long>(allocations), COUNTED_FRAMES);
+                exit_code = allocations == 0 ? 0 : 1;
+                glfwSetWindowShouldClose(window.handle, GLFW_TRUE);
+            }
+            frame_count++;
+#endif
             poly::vk::begin_frame(context, dsc);
             auto current_cmd = dsc.command_buffers.values[dsc.current_frame];
             {
+                POLY_TRACE_ZONE("record commands");
                 poly::vk::begin_recording_commands(current_cmd);
-                poly::vk::begin_render_pass(current_cmd, context.v_render_pass, context.swapchain.framebuffers[dsc.current_image_index], context.swapchain.v_extent);
+                poly::vk::begin_gpu_profiler_frame(context, profiler, current_cmd, dsc.current_frame, sync.frame_number);
+
+                poly::vk::begin_gpu_scope(profiler, current_cmd, "culling");
+                poly::vk::record_gpu_culling(current_cmd, culling, glm::mat4(1.0f)); // The triangle is already in clip space.
+                poly::vk::end_gpu_scope(profiler, current_cmd);
+
+                poly::vk::begin_gpu_scope(profiler, current_cmd, "main pass");
+                poly::vk::begin_render_pass(current_cmd, context.v_render_pass, context.swapchain.framebuffers[dsc.current_image_index], context.swapchain.v_extent, VK_SUBPASS_CONTENTS_INLINE);
 
                 auto extent = context.swapchain.v_extent;
 
-                std::vector<VkRect2D> scissors{
-                    {{0, 0}, extent}
-                };
-                vkCmdSetScissor(current_cmd.buf, 0, static_cast<uint32_t>(scissors.size()), scissors.data());
+                VkRect2D scissor{ {0, 0}, extent };
+                vkCmdSetScissor(current_cmd.buf, 0, 1, &scissor);
 
-                std::vector<VkViewport> viewports{
-                    { 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f }
-                };
-                vkCmdSetViewport(current_cmd.buf, 0, static_cast<uint32_t>(viewports.size()), viewports.data());
+                VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+                vkCmdSetViewport(current_cmd.buf, 0, 1, &viewport);
 
                 vkCmdBindPipeline(current_cmd.buf, dsc.pipeline.v_bind_point, dsc.pipeline.v_pipeline);
 
-                VkBuffer raw_vertex_bufs[] = {vertex_buf.value};
-                VkDeviceSize raw_offsets[] = {0};
-                vkCmdBindVertexBuffers(current_cmd.buf, 0, 1, raw_vertex_bufs, raw_offsets);
-                vkCmdBindIndexBuffer(current_cmd.buf, index_buf.value, 0, VK_INDEX_TYPE_UINT16);
-
-                vkCmdDrawIndexed(current_cmd.buf, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+                poly::vk::bind_geometry_pool(current_cmd, geometry);
+                poly::vk::draw_gpu_culled(current_cmd, culling);
 
                 poly::vk::end_render_pass(current_cmd);
+                poly::vk::end_gpu_scope(profiler, current_cmd);
                 poly::vk::end_recording_commands(current_cmd);
             }
             poly::vk::end_frame(context, dsc);
+
+            if (sync.frame_number == TRACE_CAPTURE_FRAMES)
+            {
+                poly::stop_trace_capture();
+                poly::vk::capture_gpu_trace(profiler, false);
+                if (!poly::vk::write_gpu_trace(profiler, TRACE_PATH))
+                {
+                    printf("Failed to write %s\n", TRACE_PATH);
+                }
+            }
+
+            if (sync.frame_number % LATENCY_REPORT_FRAMES == 0)
+            {
+                const auto& latency = sync.latency;
+                printf("submit to GPU done %.2f ms avg, %.2f ms max; submit to present %.2f ms avg, %.2f ms max\n",
+                       latency.gpu.average_ms, latency.gpu.max_ms, latency.present.average_ms, latency.present.max_ms);
+                printf("GPU frame %.3f ms; culling %.3f ms, main pass %.3f ms\n",
+                       poly::vk::get_gpu_frame_ms(profiler), poly::vk::get_gpu_scope_ms(profiler, "culling"), poly::vk::get_gpu_scope_ms(profiler, "main pass"));
+            }
         }
     );
 
     vkDeviceWaitIdle(context.device.v_logical);
 
-    poly::vk::destroy_buffer(context, vertex_buf);
-    poly::vk::destroy_buffer(context, index_buf);
+    poly::vk::destroy_gpu_profiler(context, profiler);
+    poly::vk::destroy_gpu_culling(context, culling);
+    poly::vk::free_mesh(context, geometry, triangle, true);
+    poly::vk::destroy_geometry_pool(context, geometry);
 
     poly::vk::destroy_pipeline(context, pipeline);
     poly::vk::destroy_synchron(context, sync);
     context.cleanup();
 
+#ifdef POLYMORPH_COUNT_ALLOCATIONS
+    return exit_code;
+#else
     return 0;
+#endif
 }
\ No newline at end of file
@@ -1,10 +1,26 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 
 namespace poly
 {
+    /// @brief A read-only view of a whole file mapped into memory, paged in by the OS as it is read.
+    struct mapped_file // file.cpp
+    {
+        const uint8_t* data;
+        size_t         size;
+
+        void*          file_handle;    // Windows only.
+        void*          mapping_handle; // Windows only.
+        int            descriptor;     // POSIX only.
+    };
+
     std::vector<char> read_file_vec_u8(const std::string& path);
     std::string read_file_str(const std::string& path);
-}
\ No newline at end of file
+
+    void map_file(mapped_file& file, const std::string& path);
+    void unmap_file(mapped_file& file);
+}
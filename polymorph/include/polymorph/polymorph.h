@@ -1,7 +1,9 @@
 #pragma once
 
 #include "error.h"
+#include "trace.h"
 #include "window.h"
+#include "worker.h"
 
 #include "vulkan/context.h"
 #include "vulkan/defines.h"
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#ifdef POLYMORPH_TRACE
+#define POLY_TRACE_CONCAT_INNER(a, b) a##b
+#define POLY_TRACE_CONCAT(a, b) POLY_TRACE_CONCAT_INNER(a, b)
+
+/// @brief Times the rest of the enclosing scope as a zone with the given name, which must be a string literal.
+#define POLY_TRACE_ZONE(name) ::poly::trace_zone POLY_TRACE_CONCAT(poly_trace_zone_, __LINE__)(name)
+
+/// @brief Times the rest of the enclosing function as a zone named after it.
+#define POLY_TRACE_FUNCTION() POLY_TRACE_ZONE(__func__)
+#else
+#define POLY_TRACE_ZONE(name)
+#define POLY_TRACE_FUNCTION()
+#endif // POLYMORPH_TRACE
+
+namespace poly
+{
+    constexpr uint32_t TRACE_THREAD_CAPACITY = 1 << 16; // Zones kept per thread per capture, later zones are dropped.
+
+    /// @brief Set while zones are being captured, checked by every zone before it reads the clock.
+    inline std::atomic<bool> trace_capturing{ false };
+
+    /// @brief Nanoseconds on std::chrono::steady_clock, the clock calibrated GPU profiler scopes are put on.
+    inline int64_t trace_now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /*! @brief Appends a finished zone to the calling thread's buffer.
+    *   @note Lock free, except for the first zone a thread records, which registers its buffer.
+    *   @param[in] name The name of the zone, which must outlive the capture.
+    *   @param[in] start_ns When the zone started, from @ref trace_now_ns.
+    *   @param[in] end_ns When the zone ended, from @ref trace_now_ns.
+    *   @since Indev
+    */
+    void record_trace_zone(const char* name,
+                           int64_t     start_ns,
+                           int64_t     end_ns);
+
+    /// @brief Records the scope it lives in while a capture is running, use through @ref POLY_TRACE_ZONE.
+    struct trace_zone
+    {
+        const char* name;
+        int64_t     start_ns; // -1 when nothing was capturing as the zone started.
+
+        explicit trace_zone(const char* zone_name)
+            : name(zone_name), start_ns(trace_capturing.load(std::memory_order_relaxed) ? trace_now_ns() : -1)
+        {
+        }
+
+        ~trace_zone()
+        {
+            if (start_ns >= 0)
+            {
+                record_trace_zone(name, start_ns, trace_now_ns());
+            }
+        }
+
+        trace_zone(const trace_zone&) = delete;
+        trace_zone& operator=(const trace_zone&) = delete;
+    };
+
+    /*! @brief Discards the previous capture and starts recording zones on every thread.
+    *   @since Indev
+    */
+    void start_trace_capture();
+
+    /*! @brief Stops recording zones, keeping the capture for @ref write_trace.
+    *   @since Indev
+    */
+    void stop_trace_capture();
+
+    /*! @brief Names the calling thread in written traces.
+    *   @param[in] name The name of the thread, which must outlive the process, such as a string literal.
+    *   @since Indev
+    */
+    void name_trace_thread(const char* name);
+
+    /*! @brief Writes a string as a quoted JSON string, escaping quotes and backslashes.
+    *   @param[in] file The file to write to.
+    *   @param[in] text The string to write.
+    *   @since Indev
+    */
+    void write_json_string(FILE*       file,
+                           const char* text);
+
+    /*! @brief Appends the captured zones to the trace_event array of a Chrome trace being written.
+    *   @note Every zone is written with a leading comma, so the array must already hold an event. Must not run alongside @ref start_trace_capture.
+    *   @param[in] file The trace file, positioned inside its traceEvents array.
+    *   @since Indev
+    */
+    void write_trace_events(FILE* file);
+
+    /*! @brief Writes the captured zones as a Chrome trace_event JSON file, viewable in chrome://tracing or Perfetto.
+    *   @note Zones are in microseconds on the steady clock, so the events of a GPU profiler trace can be merged in as they are.
+    *   @param[in] path The file to write.
+    *   @return True if the file was written.
+    *   @since Indev
+    */
+    bool write_trace(const std::string& path);
+}
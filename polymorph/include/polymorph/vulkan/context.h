@@ -3,30 +3,111 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <atomic>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 
 #include "utility.h"
+#include "../io/file.h"
+#include "../trace.h"
+#include "../worker.h"
 
 #include <vk_mem_alloc.h>
 
 namespace poly::vk
 {
+    /// @brief The subsystem an allocation belongs to, used to account memory usage.
+    enum class memory_category
+    {
+        general,
+        geometry,
+        texture,
+        staging,
+        transient,
+        render_target,
+        count
+    };
+
+    constexpr uint32_t MEMORY_CATEGORY_COUNT = static_cast<uint32_t>(memory_category::count);
+
+    /// @brief The layout and last accesses of a resource, from which the barrier before its next access is derived.
+    struct resource_state // barrier.cpp
+    {
+        VkImageLayout         layout;       // Always undefined for buffers.
+        VkPipelineStageFlags2 write_stages; // Of the last write or layout transition.
+        VkAccessFlags2        write_access;
+        VkPipelineStageFlags2 read_stages;  // Of the reads since then, each of which already waits for it.
+        VkAccessFlags2        read_access;  // Of those reads, which the write is only made visible to.
+    };
+
     /// @brief A wrapper for a vulkan buffer and its allocation.
     struct buffer // buffer.cpp
     {
         VkBuffer value;
         VmaAllocation allocation;
+        VkDeviceSize size;
+        VkBufferUsageFlags usage;
+        memory_category category;
+        void* mapped; // Only set for persistently mapped buffers.
+        resource_state state;
     };
 
     /// @brief A wrapper for a vulkan image and its allocation.
     struct image // image.cpp
     {
-        VkImage        v_image;
-        VkImageView    v_view;
-        VkDeviceMemory v_memory;
+        VkImage         v_image;
+        VkImageView     v_view;
+        VmaAllocation   allocation; // Null for images created without VMA, whose handle is destroyed on its own.
+
+        VkFormat        format;
+        VkExtent3D      extent;
+        uint32_t        mip_levels;
+        uint32_t        array_layers;
+        memory_category category;
+        resource_state  state;      // Covers every subresource, which are transitioned together.
+    };
+
+    /// @brief The smallest copyable unit of a format, which is a single texel for uncompressed formats.
+    struct format_block // image.cpp
+    {
+        uint32_t width;  // In texels.
+        uint32_t height;
+        uint32_t bytes;  // 0 for formats of an unknown size, which cannot be uploaded.
+    };
+
+    /// @brief A struct containing configuration details to create an image.
+    struct image_cfg // image.cpp
+    {
+        VkImageType           type;
+        VkFormat              format;
+        VkExtent3D            extent;
+        uint32_t              mip_levels; // 0 for a full mip chain.
+        uint32_t              array_layers;
+        VkSampleCountFlagBits samples;
+        VkImageUsageFlags     usage;
+        VkImageCreateFlags    flags;
+        VkMemoryPropertyFlags memory_props;
+        memory_category       category;
+
+        /*! @brief Creates a pre-configured config for a sampled 2D texture with a full mip chain.
+        *   @static
+        *   @sa @ref image
+        *   @param[in] format The texel format.
+        *   @param[in] width The width of the top mip level.
+        *   @param[in] height The height of the top mip level.
+        *   @param[in] array_layers The number of array layers.
+        *   @since Indev
+        */
+        static image_cfg texture(VkFormat format,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 uint32_t array_layers);
     };
 
     /// @brief A wrapper for a vulkan buffer and its allocation.
@@ -35,6 +116,16 @@ namespace poly::vk
         VkFramebuffer buf;
     };
 
+    /// @brief How frames are paced to the display, trading latency against throughput and tearing.
+    enum class present_policy
+    {
+        low_latency, // Mailbox with one frame in flight, so input is sampled as late as possible without tearing.
+        throughput,  // Mailbox with every frame in flight, so neither the CPU nor the GPU waits on the other.
+        vsync,       // FIFO with two frames in flight, which never tears or drops a frame.
+        immediate,   // Presents without waiting for vertical blank, tearing for the lowest latency.
+        count
+    };
+
     /// @brief A wrapper for a vulkan swapchain, and associated objects and informations.
     struct swapchain // swapchain.cpp
     {
@@ -48,8 +139,11 @@ namespace poly::vk
         std::vector<VkImageView> image_views;
 
         std::vector<framebuffer> framebuffers;
+        std::vector<VkSemaphore> semas_render_finished; // One per image, as a present holds its semaphore until the image is acquired again.
 
-        uint32_t max_frames_in_flight = 2;
+        present_policy           policy = present_policy::throughput;
+        uint32_t                 max_frames_in_flight = 3; // Per frame resources are created for this many, the most any policy uses.
+        uint32_t                 frames_in_flight = 3;     // Set by the policy.
     };
 
     /// @brief A wrapper for a vulkan command buffer.
@@ -58,6 +152,509 @@ namespace poly::vk
         VkCommandBuffer buf;
     };
 
+    /// @brief A handle to the batch an upload was recorded into, used to poll or wait for its completion.
+    struct upload_ticket
+    {
+        uint64_t value = 0;
+    };
+
+    /// @brief The lifecycle of an upload batch.
+    enum class upload_batch_state
+    {
+        idle,        // Free to record into.
+        recording,   // Commands have been recorded but not yet submitted.
+        in_flight,   // Submitted to the transfer queue.
+        transferred, // Transfers done, awaiting the ownership acquire on the graphics queue.
+        handed_off   // Acquire submitted to the graphics queue, complete once its fence signals.
+    };
+
+    /// @brief A mip chain to be generated from the top level of an image once its upload reaches the graphics queue.
+    struct mip_generation
+    {
+        VkImage       image;
+        VkExtent3D    extent;
+        uint32_t      mip_levels;
+        uint32_t      array_layers;
+        VkFilter      filter;
+        VkImageLayout final_layout;
+    };
+
+    /// @brief A timeline semaphore signalled by the submits of one queue, with a value that only increases.
+    struct queue_timeline // sync.cpp
+    {
+        VkSemaphore v_semaphore;
+        uint64_t    submitted; // The value signalled by the last submit.
+    };
+
+    /// @brief A set of transfers recorded into a single command buffer and tracked by the transfer timeline.
+    struct upload_batch // upload.cpp
+    {
+        VkCommandBuffer                    v_cmd;            // Its submit signals the transfer timeline to the batch id.
+
+        VkCommandBuffer                    v_acquire_cmd;     // Graphics family, only used with an ownership transfer.
+        VkFence                            v_acquire_fence;
+        VkSemaphore                        v_transferred;     // Signalled by the transfer submit, waited on by the acquire.
+
+        std::vector<VkBufferMemoryBarrier> buffer_releases;
+        std::vector<VkImageMemoryBarrier>  image_releases;
+        std::vector<mip_generation>        mip_generations;   // Recorded on the graphics queue, after the releases.
+
+        uint64_t                           id;
+        VkDeviceSize                       ring_end;          // Staging ring head once this batch's writes were made.
+        upload_batch_state                 state;
+    };
+
+    /// @brief Owns a persistently mapped staging ring and batches many uploads into few submits on the transfer queue.
+    struct upload_manager // upload.cpp
+    {
+        VkCommandPool             v_command_pool;         // Transfer family.
+        VkCommandPool             v_acquire_command_pool; // Graphics family.
+        bool                      ownership_transfer;     // The transfer and graphics families differ.
+
+        buffer                    staging;
+        VkDeviceSize              capacity;
+        VkDeviceSize              head; // Monotonic write cursor into the ring.
+        VkDeviceSize              tail; // Monotonic cursor of the oldest byte still read by the GPU.
+
+        queue_timeline            transfer;
+        std::vector<upload_batch> batches;
+        uint32_t                  current;
+        uint64_t                  next_id;
+        uint64_t                  completed_id; // The newest batch whose work has finished on every queue it runs on.
+    };
+
+    /// @brief How a transient allocation is bound, which decides its alignment.
+    enum class transient_usage
+    {
+        uniform,
+        storage,
+        vertex,
+        index
+    };
+
+    /// @brief A suballocation of a frame allocator, valid until its frame is next begun.
+    struct transient_allocation
+    {
+        VkBuffer     buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        void*        mapped;
+    };
+
+    /// @brief A linear allocator over one persistently mapped buffer per frame in flight, rewound by @ref begin_frame.
+    struct frame_allocator // transient.cpp
+    {
+        std::vector<buffer> buffers;
+        VkDeviceSize        capacity;
+        VkDeviceSize        head;
+        uint32_t            frame;
+
+        VkDeviceSize        uniform_alignment;
+        VkDeviceSize        storage_alignment;
+    };
+
+    /// @brief The header at the start of a texture container file, followed by a level table of mip_levels entries, top level first.
+    struct texture_container_header
+    {
+        char     magic[4];      // "PTEX"
+        uint32_t version;
+        VkFormat format;        // Uncompressed formats only.
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_levels;
+        uint32_t array_layers;
+        uint32_t reserved;
+    };
+
+    /// @brief Where a mip level, every array layer of it tightly packed, lies within a texture container file.
+    struct texture_container_level
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    /// @brief A texture whose mip chain is streamed from a mapped container file, with only a low resolution tail resident at load.
+    struct streamed_texture // streaming.cpp
+    {
+        mapped_file                    file;
+        const texture_container_level* levels; // Points into the mapping.
+
+        VkFormat                       format;
+        VkExtent3D                     extent;        // Of the top level in the file.
+        uint32_t                       mip_levels;    // In the file.
+        uint32_t                       array_layers;
+        uint32_t                       tail_mip;      // The top level of the tail which is always resident.
+
+        image                          img;           // Holds the levels from resident_mip down, its level 0 is resident_mip.
+        uint32_t                       resident_mip;
+        uint32_t                       requested_mip;
+
+        image                          pending;       // Being uploaded, replaces img once its upload completes.
+        uint32_t                       pending_mip;
+        upload_ticket                  pending_ticket;
+        bool                           pending_active;
+    };
+
+    /// @brief The shape of a render target, which decides the images it may share memory with.
+    struct render_target_desc
+    {
+        VkFormat              format;
+        VkExtent2D            extent;
+        VkImageUsageFlags     usage;   // Include VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT for attachments never read outside their render pass.
+        VkSampleCountFlagBits samples;
+    };
+
+    /// @brief A render target and the range of passes it is used in, first and last inclusive.
+    struct render_target_request
+    {
+        render_target_desc desc;
+        uint32_t           first_use;
+        uint32_t           last_use;
+    };
+
+    /// @brief The images and memory resolved for one frame in flight, rebuilt only when the requests change.
+    struct render_target_frame
+    {
+        std::vector<render_target_request> layout;  // The requests these images were built for.
+        std::vector<image>                 images;  // Bound to the memory below, not owning it.
+        std::vector<VmaAllocation>         memory;  // One per aliasing slot.
+    };
+
+    /// @brief Hands out transient render targets per frame, aliasing the memory of targets whose uses do not overlap.
+    struct render_target_pool // rendertarget.cpp
+    {
+        std::vector<render_target_request> requests; // Of the frame being recorded.
+        std::vector<render_target_frame>   frames;
+        uint32_t                           frame;
+        bool                               supports_lazy_memory;
+    };
+
+    /// @brief An access a resource is about to be used with.
+    struct resource_access
+    {
+        VkImageLayout         layout; // Ignored for buffers.
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2        access;
+    };
+
+    /// @brief Image and buffer barriers gathered from tracked resources, recorded together by one vkCmdPipelineBarrier2.
+    struct barrier_batch // barrier.cpp
+    {
+        std::vector<VkImageMemoryBarrier2>  images;
+        std::vector<VkBufferMemoryBarrier2> buffers;
+    };
+
+    /// @brief How a render graph pass uses a resource, which decides its layout, stages and access.
+    enum class graph_access
+    {
+        color_attachment,  // Read and written as a colour attachment.
+        depth_attachment,  // Read and written as a depth stencil attachment.
+        depth_read,        // Tested against or sampled as a read only depth stencil attachment.
+        sampled,           // Sampled in a shader.
+        storage_read,      // Read as a storage image or buffer.
+        storage,           // Read and written as a storage image or buffer.
+        transfer_src,
+        transfer_dst,
+        indirect,          // Read as indirect draw or dispatch arguments.
+        vertex,            // Read as vertex or index data.
+        uniform,           // Read as a uniform buffer.
+        count
+    };
+
+    /// @brief The index of a resource within a render graph.
+    typedef uint32_t graph_resource;
+
+    struct render_graph;
+
+    /// @brief Records the commands of a render graph pass, after the barriers it needs.
+    typedef void (*graph_execute)(const command_buffer& command_buffer, const render_graph& graph, void* data);
+
+    /// @brief A resource used by the passes of a render graph, imported from outside or transient to the frame.
+    struct graph_resource_entry
+    {
+        image*             img;          // Imported image, or nullptr.
+        buffer*            buf;          // Imported buffer, or nullptr.
+        render_target_desc desc;         // Of a transient image.
+        uint32_t           target;       // The render target of a transient image.
+        VkImageLayout      final_layout; // VK_IMAGE_LAYOUT_UNDEFINED leaves the image as its last pass used it.
+        VkImageAspectFlags aspect;
+        uint32_t           first_use;    // Scheduled positions of the first and last live passes using it.
+        uint32_t           last_use;
+        resource_state     state;        // Tracked while the barriers are computed, then written back to imported resources.
+    };
+
+    /// @brief One resource used by a render graph pass.
+    struct graph_use
+    {
+        graph_resource        resource;
+        graph_access          access;
+        VkPipelineStageFlags2 stages; // Narrows the shader stages of the access, 0 for every stage it may happen in.
+    };
+
+    /// @brief A render graph pass, its uses and the barriers recorded before it.
+    struct graph_pass
+    {
+        const char*   name;
+        graph_execute execute;
+        void*         data;
+        uint32_t      first_use;
+        uint32_t      use_count;
+        bool          side_effect; // Kept even when nothing reads what it writes.
+        bool          live;
+
+        uint32_t      first_image_barrier;
+        uint32_t      image_barrier_count;
+        uint32_t      first_buffer_barrier;
+        uint32_t      buffer_barrier_count;
+    };
+
+    /// @brief The passes of a frame, culled, ordered and separated by the barriers their declared uses need.
+    struct render_graph // rendergraph.cpp
+    {
+        std::vector<graph_resource_entry>   resources;
+        std::vector<graph_pass>             passes;            // In declaration order.
+        std::vector<graph_use>              uses;
+        std::vector<uint32_t>               order;             // Live passes in scheduled order.
+
+        std::vector<VkImageMemoryBarrier2>  image_barriers;
+        std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+        graph_pass                          final_transitions; // Of imported images to their final layouts.
+
+        render_target_pool*                 targets;
+
+        std::vector<uint8_t>                needed;            // Compile scratch, kept between frames so a steady frame compiles without allocating.
+        std::vector<uint32_t>               last_writer;
+        std::vector<uint32_t>               read_head;         // Linked lists of the reads since the last write, through next_read.
+        std::vector<uint32_t>               next_read;
+        std::vector<uint32_t>               edges;             // Pairs of pass indices, producer then consumer.
+        std::vector<uint32_t>               successor_start;   // The consumers of pass p are successors[successor_start[p]] up to successor_start[p + 1].
+        std::vector<uint32_t>               successors;
+        std::vector<uint32_t>               in_degree;
+        std::vector<uint32_t>               follows;           // The last scheduled pass each pass depends on.
+    };
+
+    /// @brief A single region of a buffer to buffer copy.
+    struct buffer_copy
+    {
+        VkBuffer     src;
+        VkBuffer     dst;
+        VkDeviceSize src_offset;
+        VkDeviceSize dst_offset;
+        VkDeviceSize size;
+    };
+
+    /// @brief A single region of a buffer to image copy.
+    struct buffer_image_copy
+    {
+        VkBuffer          src;
+        VkImage           dst;
+        VkImageLayout     dst_layout; // Either VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL or VK_IMAGE_LAYOUT_GENERAL.
+        VkBufferImageCopy region;
+    };
+
+    /// @brief Copy regions gathered over a frame and recorded together, with neighbouring regions merged.
+    struct copy_batch // buffer.cpp
+    {
+        std::vector<buffer_copy>       buffer_copies;
+        std::vector<buffer_image_copy> image_copies;
+        std::vector<VkBufferCopy>      scratch_buffer_regions; // Reused between recordings.
+        std::vector<VkBufferImageCopy> scratch_image_regions;
+    };
+
+    /// @brief A pair of large device local vertex and index buffers, suballocated between meshes.
+    struct geometry_pool // geometry.cpp
+    {
+        buffer          vertices;
+        buffer          indices;
+
+        VmaVirtualBlock vertex_block; // Measured in vertices, so ranges stay aligned to the stride.
+        VmaVirtualBlock index_block;  // Measured in indices.
+
+        uint32_t        vertex_stride;
+        VkIndexType     index_type;
+    };
+
+    /// @brief The range of a mesh within a geometry pool, addressed by its base vertex and first index.
+    struct mesh_range
+    {
+        VmaVirtualAllocation vertex_allocation;
+        VmaVirtualAllocation index_allocation;
+
+        int32_t              vertex_offset;
+        uint32_t             vertex_count;
+        uint32_t             first_index;
+        uint32_t             index_count;
+    };
+
+    /// @brief A wrapper for a vulkan pipeline.
+    struct pipeline // pipeline.cpp
+    {
+        VkPipeline          v_pipeline;
+        VkPipelineLayout    v_layout;
+        VkPipelineBindPoint v_bind_point;
+    };
+
+    /// @brief The bounds and draw arguments of one object, as read by the culling shader. Matches the std430 layout in cull.comp.
+    struct gpu_object
+    {
+        glm::vec4 sphere;         // Centre in xyz, radius in w, in the space of the culling matrix.
+        uint32_t  index_count;
+        uint32_t  first_index;
+        int32_t   vertex_offset;
+        uint32_t  instance_count;
+    };
+
+    /// @brief Objects culled against the view frustum by a compute pass, which writes the indirect draws for everything visible.
+    struct gpu_culling // culling.cpp
+    {
+        buffer                objects;    // gpu_object[capacity].
+        buffer                commands;   // VkDrawIndexedIndirectCommand[capacity], written by the culling shader.
+        buffer                count;      // The number of compacted commands.
+
+        uint32_t              capacity;
+        uint32_t              object_count;
+        bool                  compact;    // Draw with vkCmdDrawIndexedIndirectCount, otherwise culled draws keep their slot with no instances.
+        bool                  multi_draw; // Draw every slot in one call, and give each draw the index of its object as its first instance.
+
+        VkDescriptorSetLayout v_set_layout;
+        VkDescriptorPool      v_descriptor_pool;
+        VkDescriptorSet       v_set;
+        pipeline              cull;
+    };
+
+    /// @brief The type of object held by a deferred deletion.
+    enum class deletion_type
+    {
+        buffer,
+        image,
+        pipeline,
+        framebuffer,
+        mesh
+    };
+
+    /// @brief An object waiting for the GPU to finish with it before being destroyed.
+    struct deferred_deletion
+    {
+        deletion_type  type;
+        buffer         buf;
+        image          img;
+        pipeline       pipe;
+        framebuffer    fb;
+        geometry_pool* pool; // The pool a deferred mesh range returns to.
+        mesh_range     mesh;
+    };
+
+    /// @brief Objects awaiting destruction, bucketed by the frame in flight they were released during.
+    struct deletion_queue // deletion.cpp
+    {
+        std::vector<std::vector<deferred_deletion>> frames;
+        uint32_t                                    current;
+    };
+
+    /// @brief The budget and usage of every memory heap, refreshed once per frame by @ref begin_frame.
+    struct memory_budget // memory.cpp
+    {
+        VmaBudget heaps[VK_MAX_MEMORY_HEAPS];
+        uint32_t  heap_count;
+        uint32_t  frame_index; // Monotonic, unlike the frame in flight.
+    };
+
+    /// @brief Live allocation counters per category, updated as allocations are made and freed from any thread.
+    struct memory_stats // memory.cpp
+    {
+        std::atomic<uint64_t> counts[MEMORY_CATEGORY_COUNT];
+        std::atomic<uint64_t> bytes[MEMORY_CATEGORY_COUNT];
+        std::atomic<uint64_t> peak_bytes[MEMORY_CATEGORY_COUNT];
+    };
+
+    /// @brief A snapshot of the memory used by a category.
+    struct memory_category_stats
+    {
+        uint64_t     allocation_count;
+        VkDeviceSize bytes;
+        VkDeviceSize peak_bytes;
+    };
+
+    /// @brief A snapshot of the memory allocated from a memory type.
+    struct memory_type_stats
+    {
+        uint32_t              heap_index;
+        VkMemoryPropertyFlags flags;
+        uint32_t              block_count;
+        uint32_t              allocation_count;
+        VkDeviceSize          block_bytes;      // Device memory allocated by VMA.
+        VkDeviceSize          allocation_bytes; // Memory in use by allocations within those blocks.
+        float                 fragmentation;    // 0 when the free memory is one range, approaching 1 as it splits up.
+    };
+
+    /// @brief A snapshot of memory usage per category and per memory type.
+    struct memory_report
+    {
+        memory_category_stats          categories[MEMORY_CATEGORY_COUNT];
+        std::vector<memory_type_stats> types;
+    };
+
+    /// @brief Moves movable buffers into fewer, denser memory blocks over several frames.
+    struct defragmenter // memory.cpp
+    {
+        VmaDefragmentationContext      v_context;
+        VmaDefragmentationPassMoveInfo pass;
+        bool                           active;
+        bool                           pass_in_flight;
+        VkDeviceSize                   max_bytes_per_pass;
+
+        VkCommandPool                  v_command_pool; // Graphics family, the copies are ordered after the frames that used the old buffers.
+        VkCommandBuffer                v_cmd;
+        uint64_t                       pass_frame;     // The frame recorded as the pass in flight was submitted, after which nothing reads its old regions.
+
+        std::vector<buffer*>           pending;        // Wrappers patched by the pass being recorded. Their old handles go through the deletion queue.
+        std::vector<buffer*>           moved;          // Wrappers patched by the last step, whose descriptors must be rewritten before the frame is recorded.
+    };
+
+    /// @brief Hashes every field of a create info that affects the created handle, ignoring sType and pNext.
+    struct create_info_hash // cache.cpp
+    {
+        size_t operator()(const VkSamplerCreateInfo& info) const;
+        size_t operator()(const VkImageViewCreateInfo& info) const;
+    };
+
+    /// @brief Compares every field of a create info that affects the created handle, ignoring sType and pNext.
+    struct create_info_equal // cache.cpp
+    {
+        bool operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const;
+        bool operator()(const VkImageViewCreateInfo& a, const VkImageViewCreateInfo& b) const;
+    };
+
+    /// @brief A cached sampler and the number of users holding it.
+    struct cached_sampler
+    {
+        VkSampler handle;
+        uint32_t  refs;
+    };
+
+    /// @brief A cached image view and the number of users holding it.
+    struct cached_image_view
+    {
+        VkImageView handle;
+        uint32_t    refs;
+    };
+
+    /// @brief Samplers deduplicated by their create info.
+    struct sampler_cache // cache.cpp
+    {
+        std::mutex                                                                                 mutex;
+        std::unordered_map<VkSamplerCreateInfo, cached_sampler, create_info_hash, create_info_equal> entries;
+        std::unordered_map<VkSampler, VkSamplerCreateInfo>                                          keys; // Reverse lookup for release.
+    };
+
+    /// @brief Image views deduplicated by their create info.
+    struct image_view_cache // cache.cpp
+    {
+        std::mutex                                                                                      mutex;
+        std::unordered_map<VkImageViewCreateInfo, cached_image_view, create_info_hash, create_info_equal> entries;
+        std::unordered_map<VkImageView, VkImageViewCreateInfo>                                           keys; // Reverse lookup for release.
+    };
+
     /// @brief A wrapper for a vulkan logical and physical device, along with a command pool and queue information.
     struct device // device.cpp
     {
@@ -68,10 +665,26 @@ namespace poly::vk
         uint32_t                  graphics_queue_index;
         uint32_t                  present_queue_index;
         uint32_t                  compute_queue_index;
+        uint32_t                  transfer_queue_index;
+
+        bool                      supports_memory_budget; // VK_EXT_memory_budget is enabled.
+        bool                      supports_draw_indirect_count; // drawIndirectCount is enabled.
+        bool                      supports_multi_draw_indirect; // multiDrawIndirect and drawIndirectFirstInstance are enabled.
+        bool                      supports_synchronization2; // VK_KHR_synchronization2 is enabled, otherwise barriers fall back to vkCmdPipelineBarrier.
+        PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2; // Null without VK_KHR_synchronization2.
+        bool                      supports_present_wait;     // VK_KHR_present_id and VK_KHR_present_wait are enabled, so present latency can be measured.
+        PFN_vkWaitForPresentKHR   wait_for_present;          // Null without VK_KHR_present_wait.
+        bool                      supports_pipeline_statistics; // pipelineStatisticsQuery is enabled.
+        float                     timestamp_period;          // Nanoseconds per timestamp tick.
+        uint32_t                  timestamp_valid_bits;      // Of the graphics family, 0 when it cannot write timestamps.
+        VkTimeDomainEXT           host_time_domain;          // VK_TIME_DOMAIN_DEVICE_EXT when timestamps cannot be calibrated against the CPU clock.
+        PFN_vkGetCalibratedTimestampsEXT get_calibrated_timestamps; // Null without VK_EXT_calibrated_timestamps.
+        float                     max_sampler_anisotropy; // 0 when anisotropic filtering is unsupported.
                                   
         VkQueue                   v_graphics_queue;
         VkQueue                   v_present_queue;
         VkQueue                   v_compute_queue;
+        VkQueue                   v_transfer_queue;
 
         swapchain_support_details swapchain_details;
     };
@@ -83,11 +696,20 @@ namespace poly::vk
         VkDebugUtilsMessengerEXT v_debug_messenger;
         VkSurfaceKHR             v_surface;
         VkRenderPass             v_render_pass; // TODO: consider configurability
+        VkPipelineCache          v_pipeline_cache; // Used by every pipeline, persisted between runs.
 
         device                   device {};
         swapchain                swapchain {};
 
         VmaAllocator             allocator;
+        memory_budget            budget {};
+        mutable memory_stats     stats {}; // Updated by allocations made through a const context.
+        mutable sampler_cache    samplers {};
+        mutable image_view_cache image_views {};
+
+        upload_manager           uploads {};
+        frame_allocator          transient {};
+        deletion_queue           deletions {};
 
         std::string              app_name;
         GLFWwindow*              glfw_window;
@@ -201,20 +823,50 @@ namespace poly::vk
         static gfx_pipeline_cfg default(const context& context);
     };
 
-    /// @brief A wrapper for several synchronization objects pertaining to drawing frames.
-    struct synchron // sync.cpp
+    /// @brief A struct containing configuration details to create a compute pipeline.
+    struct compute_pipeline_cfg // pipeline.cpp
     {
-        std::vector<VkSemaphore> semas_image_available;
-        std::vector<VkSemaphore> semas_render_finished;
-        std::vector<VkFence>     fences_in_flight;
+        struct
+        {
+            std::vector<VkDescriptorSetLayout> set_layouts;
+            std::vector<VkPushConstantRange>   push_const_ranges;
+        } pipeline_layout;
+
+        gfx_pipeline_cfg::shader_stage shader_stage; // The module is destroyed once the pipeline is created.
     };
 
-    /// @brief A wrapper for a vulkan pipeline.
-    struct pipeline // pipeline.cpp
+    constexpr uint32_t FRAME_LATENCY_HISTORY = 16;
+
+    /// @brief Running statistics of a latency, in milliseconds.
+    struct latency_stats
     {
-        VkPipeline          v_pipeline;
-        VkPipelineLayout    v_layout;
-        VkPipelineBindPoint v_bind_point;
+        float    last_ms;
+        float    average_ms; // Exponential moving average.
+        float    max_ms;     // Since the stats were last reset.
+        uint32_t samples;
+    };
+
+    /// @brief The time from the CPU submit of each frame until its GPU work, and its present, are seen to finish.
+    struct frame_latency // latency.cpp
+    {
+        latency_stats gpu;
+        latency_stats present;                              // Only measured with VK_KHR_present_wait.
+
+        int64_t       submit_ns[FRAME_LATENCY_HISTORY];     // Indexed by frame number.
+        uint64_t      gpu_pending;                          // The oldest frame whose GPU work is not yet seen to finish.
+        uint64_t      present_pending;                      // The oldest frame whose present is not yet seen.
+    };
+
+    /// @brief A wrapper for several synchronization objects pertaining to drawing frames.
+    struct synchron // sync.cpp
+    {
+        std::vector<VkSemaphore> semas_image_available; // Binary, as the swapchain only takes binary semaphores.
+
+        queue_timeline           graphics;              // Signalled to its frame number by the submit of each frame.
+        std::vector<uint64_t>    frame_numbers;         // The frame number each frame in flight last submitted, 0 before its first.
+        uint64_t                 frame_number;          // Of the frame being recorded, counting from 1. Doubles as the present id.
+
+        frame_latency            latency;
     };
 
     /// @brief A wrapper for a description set layout and its buffer.
@@ -230,6 +882,136 @@ namespace poly::vk
         std::vector<command_buffer> values;
     };
 
+    /// @brief Command buffers for the compute queue, which overlap the graphics work of the frame and are waited on by its submit.
+    struct async_compute // compute.cpp
+    {
+        VkCommandPool                v_command_pool; // From the compute family.
+        std::vector<VkCommandBuffer> v_cmds;         // One per frame in flight.
+        queue_timeline               timeline;       // Signalled by the compute submit of each frame, waited on by its graphics submit.
+        std::vector<uint64_t>        frame_values;   // The timeline value each command buffer was last submitted with.
+
+        uint32_t                     frame;
+        bool                         dedicated;      // The compute family is not the graphics family, so shared resources need ownership transfers.
+        bool                         pending;        // Submitted, and not yet waited on by a graphics submit.
+        VkPipelineStageFlags         wait_stages;    // The graphics stages which wait for the pending submit.
+    };
+
+    /// @brief A command pool per recording thread per frame in flight, with the secondary command buffers allocated from each.
+    struct thread_command_pools // parallel.cpp
+    {
+        std::vector<VkCommandPool>                pools;       // Indexed by frame * thread_count + thread.
+        std::vector<std::vector<VkCommandBuffer>> secondaries; // Allocated from the pool of the same index, reused every frame.
+        std::vector<uint32_t>                     used;        // Secondaries handed out from each pool this frame.
+        std::vector<VkCommandBuffer>              recorded;    // The secondaries of the last parallel recording, in draw order.
+
+        uint32_t                                  thread_count;
+        uint32_t                                  frame;
+    };
+
+    constexpr uint32_t DRAW_PACKET_MAX_SETS = 4;
+
+    /// @brief Everything needed to record a single draw, bound only where it differs from the draw before it.
+    struct draw_packet
+    {
+        uint64_t           key;         // Draws are recorded in ascending key order, see @ref make_sort_key.
+
+        const pipeline*    pipe;
+        VkDescriptorSet    sets[DRAW_PACKET_MAX_SETS];
+        uint32_t           set_count;
+
+        VkBuffer           vertex_buffer;
+        VkDeviceSize       vertex_buffer_offset;
+        VkBuffer           index_buffer; // VK_NULL_HANDLE for a non-indexed draw.
+        VkDeviceSize       index_buffer_offset;
+        VkIndexType        index_type;
+
+        uint32_t           count;       // Indices, or vertices for a non-indexed draw.
+        uint32_t           first;       // First index, or first vertex for a non-indexed draw.
+        int32_t            vertex_offset;
+        uint32_t           instance_count;
+        uint32_t           first_instance;
+
+        VkShaderStageFlags push_stages;
+        uint32_t           push_size;   // 0 for no push constants.
+        uint32_t           push_data;   // Offset of the push constants in the queue, set by @ref submit_draw.
+    };
+
+    /// @brief The state changes a render queue recorded, and the ones it skipped as redundant.
+    struct render_queue_stats
+    {
+        uint32_t draws;
+        uint32_t pipeline_binds;
+        uint32_t set_binds;
+        uint32_t buffer_binds;
+        uint32_t push_constants;
+        uint32_t skipped;
+    };
+
+    /// @brief Draw packets gathered over a frame, radix sorted by key and recorded with redundant state changes removed.
+    struct render_queue // renderqueue.cpp
+    {
+        std::vector<draw_packet> packets;
+        std::vector<uint8_t>     push_data;
+
+        std::vector<uint64_t>    keys;    // Sort scratch, kept between frames.
+        std::vector<uint64_t>    keys_scratch;
+        std::vector<uint32_t>    order;   // Packet indices in key order once sorted.
+        std::vector<uint32_t>    order_scratch;
+    };
+
+    constexpr uint32_t GPU_PIPELINE_STATISTIC_COUNT = 5;
+
+    /// @brief The timing, and for top level scopes the pipeline statistics, of a resolved GPU profiler scope.
+    struct gpu_scope_result
+    {
+        const char* name;
+        uint32_t    depth;       // 0 for top level scopes.
+        uint64_t    frame_number;
+        int64_t     start_ns;    // On the CPU steady clock when timestamps are calibrated, otherwise on the GPU clock.
+        int64_t     duration_ns;
+
+        // Input assembly vertices, vertex shader invocations, clipping primitives, fragment and compute shader invocations.
+        uint64_t    statistics[GPU_PIPELINE_STATISTIC_COUNT];
+    };
+
+    /// @brief A scope opened on a command buffer, waiting for its queries to be resolved.
+    struct gpu_scope
+    {
+        const char* name;
+        uint32_t    depth;
+        uint32_t    statistics_query; // UINT32_MAX for nested scopes, as pipeline statistics queries cannot nest.
+    };
+
+    /// @brief The queries of one frame in flight.
+    struct gpu_profiler_frame
+    {
+        VkQueryPool            v_timestamps; // The begin and end of each scope.
+        VkQueryPool            v_statistics; // One per top level scope, VK_NULL_HANDLE without pipeline statistics.
+        std::vector<gpu_scope> scopes;
+        std::vector<uint32_t>  open;         // Indices of the scopes not yet ended, innermost last.
+        uint32_t               statistics_count;
+        uint64_t               frame_number; // 0 while nothing waits to be resolved.
+    };
+
+    /// @brief Named GPU scopes timed with timestamp queries, resolved once their frame in flight comes around again.
+    struct gpu_profiler // profiler.cpp
+    {
+        std::vector<gpu_profiler_frame> frames;
+        uint32_t                        frame;
+        uint32_t                        max_scopes;       // Per frame, later scopes are not timed.
+        bool                            statistics;
+
+        double                          ns_per_tick;
+        uint64_t                        tick_mask;        // The timestamp bits the queue writes.
+        int64_t                         gpu_to_cpu_ns;    // Added to GPU times to put them on the CPU steady clock.
+        bool                            calibrated;
+
+        std::vector<gpu_scope_result>   results;          // Of the last resolved frame.
+        std::vector<uint64_t>           query_scratch;
+        bool                            capturing;
+        std::vector<gpu_scope_result>   trace;            // Every resolved scope while capturing.
+    };
+
     /// @brief A collection of states required to draw frames.
     struct draw_state_context
     {
@@ -241,6 +1023,8 @@ namespace poly::vk
 
         uint32_t            current_frame = 0;
         uint32_t            current_image_index = 0;
+
+        async_compute*      compute = nullptr; // Waited on by the graphics submit of the frame, when it has pending work.
     };
                   
 //  ----- Contextual -----
@@ -297,6 +1081,34 @@ namespace poly::vk
     */
     void create_vma_allocator(context& context);
 
+    /*! @brief Creates the context pipeline cache, seeded from a file saved by an earlier run.
+    *   @memberof context
+    *   @note A missing, corrupt or stale file, written by another device or driver version, is ignored and the cache starts empty.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in] path The file the cache was saved to.
+    *   @since Indev
+    */
+    void create_pipeline_cache(context&           context,
+                               const std::string& path);
+
+    /*! @brief Saves the context pipeline cache, tagged with the device and driver it is valid for.
+    *   @memberof context
+    *   @note Written to a temporary file which then replaces the old one, so an interrupted save never leaves a truncated cache.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] path The file to save to.
+    *   @return True if the cache was saved.
+    *   @since Indev
+    */
+    bool save_pipeline_cache(const context&     context,
+                             const std::string& path);
+
+    /*! @brief Destroys the context pipeline cache.
+    *   @memberof context
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @since Indev
+    */
+    void destroy_pipeline_cache(context& context);
+
     /*! @brief Creates the context swapchain wrapper and populates its contents.
     *   @memberof swapchain
     *   @sa @ref context
@@ -321,6 +1133,18 @@ namespace poly::vk
     */
     void destroy_swapchain(context& context);
 
+    /*! @brief Switches how frames are paced, recreating the swapchain with the present mode and image count of the policy.
+    *   @memberof swapchain
+    *   @note Waits for the device to idle, so it is meant for settings changes rather than every frame. Falls back to FIFO when the surface lacks the mode.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] draw_state_context The frame state, whose frames in flight follow the policy.
+    *   @param[in] policy The policy to switch to.
+    *   @since Indev
+    */
+    void set_present_policy(context&            context,
+                            draw_state_context& draw_state_context,
+                            present_policy      policy);
+
     /*! @brief Creates images views for the swapchain images of the given context.
     *   @memberof swapchain
     *   @sa @ref image
@@ -355,22 +1179,1081 @@ namespace poly::vk
     */
     void create_command_pool(context& context);
 
-//  ----- Generic -----
-
-    /*! @brief Allocates and stores data to a buffer using staging.
+    /*! @brief Creates an upload manager with a persistently mapped staging ring of the given size.
+    *   @memberof upload_manager
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager to create and populate.
+    *   @param[in] capacity The size of the staging ring in bytes.
+    *   @since Indev
+    */
+    void create_upload_manager(const context&  context,
+                               upload_manager& uploads,
+                               VkDeviceSize    capacity);
+
+    /*! @brief Waits for any outstanding uploads and destroys the upload manager.
+    *   @memberof upload_manager
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_upload_manager(const context&  context,
+                                upload_manager& uploads);
+
+    /*! @brief Creates a frame allocator with one mapped buffer of the given capacity per frame in flight.
+    *   @memberof frame_allocator
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] allocator The frame allocator to create and populate.
+    *   @param[in] capacity The size in bytes available to each frame.
+    *   @param[in] frame_count The number of frames in flight.
+    *   @since Indev
+    */
+    void create_frame_allocator(const context&   context,
+                                frame_allocator& allocator,
+                                VkDeviceSize     capacity,
+                                uint32_t         frame_count);
+
+    /*! @brief Destroys the frame allocator and its buffers.
+    *   @memberof frame_allocator
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] allocator The frame allocator to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_frame_allocator(const context&   context,
+                                 frame_allocator& allocator);
+
+    /*! @brief Creates a deletion queue with a bucket per frame in flight.
+    *   @memberof deletion_queue
+    *   @param[in,out] deletions The deletion queue to populate.
+    *   @param[in] frame_count The number of frames in flight.
+    *   @since Indev
+    */
+    void create_deletion_queue(deletion_queue& deletions,
+                               uint32_t        frame_count);
+
+    /*! @brief Immediately destroys every object in the deletion queue.
+    *   @memberof deletion_queue
+    *   @note The device must be idle.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] deletions The deletion queue to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_deletion_queue(const context&  context,
+                                deletion_queue& deletions);
+
+//  ----- Memory -----
+
+    /*! @brief Advances the VMA frame index and refreshes the budget and usage of every heap.
+    *   @memberof memory_budget
+    *   @note Called by @ref begin_frame. Budgets are estimates unless VK_EXT_memory_budget is supported.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] budget The memory budget to refresh.
+    *   @since Indev
+    */
+    void update_memory_budget(const context& context,
+                              memory_budget& budget);
+
+    /*! @brief Returns the highest usage to budget ratio across every heap.
+    *   @memberof memory_budget
+    *   @param[in] budget The memory budget to inspect.
+    *   @return The usage of the most pressured heap as a fraction of its budget, above 1 when over budget.
+    *   @since Indev
+    */
+    float get_memory_pressure(const memory_budget& budget);
+
+    /*! @brief Accounts a new allocation to a category.
+    *   @memberof memory_stats
+    *   @note Called by the functions which allocate device memory. Thread safe.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] category The category to account the allocation to.
+    *   @param[in] size The size of the allocation in bytes.
+    *   @since Indev
+    */
+    void track_allocation(const context&  context,
+                          memory_category category,
+                          VkDeviceSize    size);
+
+    /*! @brief Removes a freed allocation from the accounting of a category.
+    *   @memberof memory_stats
+    *   @note Thread safe.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] category The category the allocation was accounted to.
+    *   @param[in] size The size of the allocation in bytes.
+    *   @since Indev
+    */
+    void track_free(const context&  context,
+                    memory_category category,
+                    VkDeviceSize    size);
+
+    /*! @brief Moves a buffer into a category and gives its allocation a debug name, shown in the VMA statistics.
+    *   @memberof buffer
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] buf The buffer wrapper to tag.
+    *   @param[in] category The category to account the buffer to.
+    *   @param[in] name The debug name of the allocation, copied by VMA.
+    *   @since Indev
+    */
+    void tag_buffer(const context&  context,
+                    buffer&         buf,
+                    memory_category category,
+                    const char*     name);
+
+    /*! @brief Returns the name of a memory category.
+    *   @param[in] category The category to name.
+    *   @return A static string naming the category.
+    *   @since Indev
+    */
+    const char* get_memory_category_name(memory_category category);
+
+    /*! @brief Takes a snapshot of the live counts, bytes and peaks of every category, and the usage and fragmentation of every memory type.
+    *   @memberof memory_stats
+    *   @note Walks every VMA block, so it is meant for tooling rather than every frame.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @return The memory report.
+    *   @since Indev
+    */
+    memory_report get_memory_report(const context& context);
+
+    /*! @brief Builds the VMA JSON statistics of every allocation, including their debug names.
+    *   @memberof memory_stats
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] detailed Whether to list every allocation and free range, rather than only the totals.
+    *   @return The JSON statistics.
+    *   @since Indev
+    */
+    std::string dump_memory_stats(const context& context,
+                                  bool           detailed);
+
+    /*! @brief Creates the command buffer a defragmenter records its copies with.
+    *   @memberof defragmenter
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] defrag The defragmenter to create and populate.
+    *   @since Indev
+    */
+    void create_defragmenter(const context& context,
+                             defragmenter&  defrag);
+
+    /*! @brief Ends any running defragmentation and destroys the defragmenter.
+    *   @memberof defragmenter
+    *   @note The device must be idle.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] defrag The defragmenter to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_defragmenter(const context& context,
+                              defragmenter&  defrag);
+
+    /*! @brief Allows the defragmenter to move a buffer, patching the wrapper with the new handle when it does.
     *   @memberof buffer
+    *   @note The wrapper is referenced by address, so it must not move while the buffer is alive. The buffer must be device local, unmapped, and created with VK_BUFFER_USAGE_TRANSFER_SRC_BIT and VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] buf The buffer wrapper to make movable.
+    *   @since Indev
+    */
+    void set_buffer_movable(const context& context,
+                            buffer&        buf);
+
+    /*! @brief Starts an incremental defragmentation of the default memory pools.
+    *   @memberof defragmenter
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] defrag The defragmenter to start.
+    *   @param[in] max_bytes_per_pass The most bytes moved by a single pass, or 0 for no limit.
+    *   @since Indev
+    */
+    void begin_defragmentation(const context& context,
+                               defragmenter&  defrag,
+                               VkDeviceSize   max_bytes_per_pass);
+
+    /*! @brief Completes the pass in flight once the frames which could still read its old regions have finished, then records and submits the next within the time budget.
+    *   @memberof defragmenter
+    *   @note Call once per frame between @ref begin_frame and recording, then rewrite the descriptors of the buffers in @ref defragmenter::moved before recording. Moves are put off while uploads are pending, as they were recorded against the old handles.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] defrag The defragmenter to advance.
+    *   @param[in] sync The sync object of the frames.
+    *   @param[in] budget_ms The CPU time in milliseconds the pass may spend creating and recording moves.
+    *   @return True once the defragmentation has finished, false otherwise.
+    *   @since Indev
+    */
+    bool step_defragmentation(context&        context,
+                              defragmenter&   defrag,
+                              const synchron& sync,
+                              double          budget_ms);
+
+    /*! @brief Waits for the pass in flight and stops the defragmentation, keeping the moves made so far.
+    *   @memberof defragmenter
+    *   @note The frame recorded when the pass in flight was submitted must have been submitted too.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] defrag The defragmenter to stop.
+    *   @param[in] sync The sync object of the frames.
+    *   @since Indev
+    */
+    void end_defragmentation(const context&  context,
+                             defragmenter&   defrag,
+                             const synchron& sync);
+
+//  ----- Cache -----
+
+    /*! @brief Returns the sampler matching the create info, creating it on first use, and adds a reference to it.
+    *   @memberof sampler_cache
+    *   @note Thread safe. The create info must not chain any pNext structures.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] info The sampler create info.
+    *   @return The shared sampler.
+    *   @since Indev
+    */
+    VkSampler acquire_sampler(const context&             context,
+                              const VkSamplerCreateInfo& info);
+
+    /*! @brief Drops a reference to a cached sampler, destroying it once none remain.
+    *   @memberof sampler_cache
+    *   @note Thread safe. The sampler must no longer be in use by the GPU when its last reference is dropped.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] sampler The sampler returned by @ref acquire_sampler.
+    *   @since Indev
+    */
+    void release_sampler(const context& context,
+                         VkSampler      sampler);
+
+    /*! @brief Returns the image view matching the create info, creating it on first use, and adds a reference to it.
+    *   @memberof image_view_cache
+    *   @note Thread safe. The create info must not chain any pNext structures.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] info The image view create info.
+    *   @return The shared image view.
+    *   @since Indev
+    */
+    VkImageView acquire_image_view(const context&               context,
+                                   const VkImageViewCreateInfo& info);
+
+    /*! @brief Drops a reference to a cached image view, destroying it once none remain.
+    *   @memberof image_view_cache
+    *   @note Thread safe. The view must no longer be in use by the GPU when its last reference is dropped.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] view The image view returned by @ref acquire_image_view.
+    *   @since Indev
+    */
+    void release_image_view(const context& context,
+                            VkImageView    view);
+
+    /*! @brief Fills a sampler create info with the same filter and address mode on every axis, sampling every mip level.
+    *   @param[in] filter The magnification, minification and mipmap filter.
+    *   @param[in] address_mode The address mode of every axis.
+    *   @param[in] max_anisotropy The anisotropy to sample with, or 0 to disable anisotropic filtering.
+    *   @return The sampler create info.
+    *   @since Indev
+    */
+    VkSamplerCreateInfo make_sampler_info(VkFilter             filter,
+                                          VkSamplerAddressMode address_mode,
+                                          float                max_anisotropy);
+
+    /*! @brief Destroys every handle left in the sampler and image view caches.
+    *   @memberof context
+    *   @note Called by @ref context::cleanup. Handles still referenced at this point were leaked, and are reported.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @since Indev
+    */
+    void destroy_handle_caches(const context& context);
+
+//  ----- Upload -----
+
+    /*! @brief Copies data into the staging ring and records its transfer into the current upload batch.
+    *   @memberof upload_manager
+    *   @note Uploads larger than the ring are split, and may block until earlier batches retire.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager to record into.
+    *   @param[in] dst The buffer to upload to, created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+    *   @param[in] dst_offset The byte offset into the destination buffer.
+    *   @param[in] size The amount of bytes to upload.
+    *   @param[in] data The data to upload.
+    *   @return A ticket for the batch the upload was recorded into.
+    *   @since Indev
+    */
+    upload_ticket enqueue_buffer_upload(const context&  context,
+                                        upload_manager& uploads,
+                                        const buffer&   dst,
+                                        VkDeviceSize    dst_offset,
+                                        VkDeviceSize    size,
+                                        const void*     data);
+
+    /*! @brief Records and uploads image data to a subresource of an image, leaving it in the given layout.
+    *   @memberof upload_manager
+    *   @note The image data must be tightly packed rows of texel blocks, see @ref get_format_block. The previous contents of the subresource are discarded.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager to record into.
+    *   @param[in,out] dst The image to upload to, created with VK_IMAGE_USAGE_TRANSFER_DST_BIT. Its tracked state is left in the final layout.
+    *   @param[in] subresource The mip level and array layers to upload to.
+    *   @param[in] extent The extent of the mip level.
+    *   @param[in] final_layout The layout the subresource is left in once the upload is complete.
+    *   @param[in] size The amount of bytes to upload, which must match the extent, layers and format exactly.
+    *   @param[in] data The data to upload.
+    *   @return A ticket for the batch the upload was recorded into.
+    *   @since Indev
+    */
+    upload_ticket enqueue_image_upload(const context&                  context,
+                                       upload_manager&                 uploads,
+                                       image&                          dst,
+                                       const VkImageSubresourceLayers& subresource,
+                                       const VkExtent3D&               extent,
+                                       VkImageLayout                   final_layout,
+                                       VkDeviceSize                    size,
+                                       const void*                     data);
+
+    /*! @brief Generates the mip chain of an image from its top level, once the upload of that level reaches the graphics queue.
+    *   @memberof upload_manager
+    *   @note Must follow an @ref enqueue_image_upload of every layer of mip 0 with a final layout of VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL. The blits run on the graphics queue, which is the only one guaranteed to support them.
+    *   @note Throws for an image of several mip levels whose format cannot be blitted, see @ref supports_mip_generation.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager to record into.
+    *   @param[in,out] img The image to generate the mips of, created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT and VK_IMAGE_USAGE_TRANSFER_DST_BIT. Its tracked state is left in the final layout.
+    *   @param[in] final_layout The layout every mip level is left in.
+    *   @return A ticket for the batch the generation was recorded into.
+    *   @since Indev
+    */
+    upload_ticket enqueue_mip_generation(const context&  context,
+                                         upload_manager& uploads,
+                                         image&          img,
+                                         VkImageLayout   final_layout);
+
+    /*! @brief Submits the current upload batch to the transfer queue, if it holds any transfers.
+    *   @memberof upload_manager
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager to flush.
+    *   @return A ticket which completes once every upload recorded so far has completed.
+    *   @since Indev
+    */
+    upload_ticket flush_uploads(const context&  context,
+                                upload_manager& uploads);
+
+    /*! @brief Hands every finished transfer batch over to the graphics queue, acquiring ownership of its resources.
+    *   @memberof upload_manager
+    *   @note Called by @ref end_frame. Only batches whose transfers have already finished are handed off, so the graphics queue never waits on the transfer queue.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager to hand off from.
+    *   @since Indev
+    */
+    void submit_upload_handoffs(const context&  context,
+                                upload_manager& uploads);
+
+    /*! @brief Polls whether the batch of the given ticket has completed, including its acquire and mip generation on the graphics queue, without blocking.
+    *   @memberof upload_manager
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager the ticket was issued by.
+    *   @param[in] ticket The ticket to poll.
+    *   @return True if the uploads have completed, false otherwise.
+    *   @since Indev
+    */
+    bool is_upload_complete(const context&  context,
+                            upload_manager& uploads,
+                            upload_ticket   ticket);
+
+    /*! @brief Blocks until the batch of the given ticket has completed, including its acquire and mip generation on the graphics queue, flushing it first if needed.
+    *   @memberof upload_manager
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] uploads The upload manager the ticket was issued by.
+    *   @param[in] ticket The ticket to wait for.
+    *   @since Indev
+    */
+    void wait_for_upload(const context&  context,
+                         upload_manager& uploads,
+                         upload_ticket   ticket);
+
+//  ----- Transient -----
+
+    /*! @brief Rewinds the frame allocator onto the buffer of the given frame.
+    *   @memberof frame_allocator
+    *   @note Called by @ref begin_frame once the frame's previous submit has finished, which makes the previous contents free to overwrite.
+    *   @param[in,out] allocator The frame allocator to rewind.
+    *   @param[in] frame The index of the frame in flight.
+    *   @since Indev
+    */
+    void reset_frame_allocator(frame_allocator& allocator,
+                               uint32_t         frame);
+
+    /*! @brief Suballocates mapped memory from the current frame, aligned for the given usage.
+    *   @memberof frame_allocator
+    *   @note The memory must be fully written before @ref end_frame, which flushes it.
+    *   @param[in,out] allocator The frame allocator to allocate from.
+    *   @param[in] size The amount of bytes to allocate.
+    *   @param[in] usage How the memory will be bound.
+    *   @return The buffer, offset and mapped pointer of the allocation.
+    *   @since Indev
+    */
+    transient_allocation allocate_transient(frame_allocator& allocator,
+                                            VkDeviceSize     size,
+                                            transient_usage  usage);
+
+    /*! @brief Flushes everything allocated from the current frame, for non-coherent memory.
+    *   @memberof frame_allocator
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] allocator The frame allocator to flush.
+    *   @since Indev
+    */
+    void flush_frame_allocator(const context&         context,
+                               const frame_allocator& allocator);
+
+//  ----- Geometry -----
+
+    /*! @brief Creates a geometry pool with room for the given number of vertices and indices.
+    *   @memberof geometry_pool
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The geometry pool to create and populate.
+    *   @param[in] vertex_stride The size in bytes of a single vertex.
+    *   @param[in] max_vertices The vertex capacity of the pool.
+    *   @param[in] index_type The type of index, either VK_INDEX_TYPE_UINT16 or VK_INDEX_TYPE_UINT32.
+    *   @param[in] max_indices The index capacity of the pool.
+    *   @since Indev
+    */
+    void create_geometry_pool(const context& context,
+                              geometry_pool& pool,
+                              uint32_t       vertex_stride,
+                              uint32_t       max_vertices,
+                              VkIndexType    index_type,
+                              uint32_t       max_indices);
+
+    /*! @brief Destroys the geometry pool and its buffers.
+    *   @memberof geometry_pool
+    *   @note Every mesh allocated from the pool must have been freed, and the deletion queue flushed of deferred frees.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The geometry pool to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_geometry_pool(const context& context,
+                               geometry_pool& pool);
+
+    /*! @brief Suballocates a mesh from the geometry pool and queues its data on the context upload manager.
+    *   @memberof geometry_pool
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The geometry pool to allocate from.
+    *   @param[out] mesh The range the mesh was given.
+    *   @param[in] vertices The vertex data, vertex_count * the pool vertex stride bytes long.
+    *   @param[in] vertex_count The number of vertices.
+    *   @param[in] indices The index data, of the pool index type.
+    *   @param[in] index_count The number of indices.
+    *   @return A ticket for the batch the upload was recorded into.
+    *   @since Indev
+    */
+    upload_ticket allocate_mesh(context&       context,
+                                geometry_pool& pool,
+                                mesh_range&    mesh,
+                                const void*    vertices,
+                                uint32_t       vertex_count,
+                                const void*    indices,
+                                uint32_t       index_count);
+
+    /*! @brief Returns the range of a mesh to the geometry pool once the frames in flight that may draw it have completed, and empties the range.
+    *   @memberof geometry_pool
+    *   @note The pool must outlive the deferred free. Pass immediate only when nothing on the GPU can use the range, such as at teardown after vkDeviceWaitIdle.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The geometry pool the mesh was allocated from.
+    *   @param[in,out] mesh The range to free.
+    *   @param[in] immediate True to return the range at once rather than through the deletion queue.
+    *   @since Indev
+    */
+    void free_mesh(context&       context,
+                   geometry_pool& pool,
+                   mesh_range&    mesh,
+                   bool           immediate = false);
+
+    /*! @brief Binds the vertex and index buffers of the geometry pool, once for every mesh drawn from it.
+    *   @related command_buffer
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in] pool The geometry pool to bind.
+    *   @since Indev
+    */
+    void bind_geometry_pool(const command_buffer& command_buffer,
+                            const geometry_pool&  pool);
+
+    /*! @brief Draws a mesh from the bound geometry pool.
+    *   @related command_buffer
+    *   @param[in] command_buffer The command buffer to write the command to.
+    *   @param[in] mesh The mesh to draw.
+    *   @param[in] instance_count The number of instances to draw.
+    *   @since Indev
+    */
+    void draw_mesh(const command_buffer& command_buffer,
+                   const mesh_range&     mesh,
+                   uint32_t              instance_count);
+
+    /*! @brief Fills an indirect draw command for a mesh, for use with vkCmdDrawIndexedIndirect.
+    *   @related mesh_range
+    *   @param[in] mesh The mesh to draw.
+    *   @param[in] instance_count The number of instances to draw.
+    *   @param[in] first_instance The first instance index.
+    *   @return The indirect draw command.
+    *   @since Indev
+    */
+    VkDrawIndexedIndirectCommand make_indirect_draw(const mesh_range& mesh,
+                                                    uint32_t          instance_count,
+                                                    uint32_t          first_instance);
+
+//  ----- Streaming -----
+
+    /*! @brief Maps a texture container file and queues the upload of its low resolution mip tail.
+    *   @memberof streamed_texture
+    *   @note The texture must not be sampled until the returned ticket completes. Throws, leaving the file unmapped, if any level does not match the extent and uncompressed format of the header.
+    *   @note The texture must be value initialised or closed, see @ref close_streamed_texture.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] texture The streamed texture to open and populate.
+    *   @param[in] path The path to the texture container file.
+    *   @param[in] tail_size The largest dimension of the top level of the resident tail, in texels.
+    *   @return A ticket for the batch the tail was recorded into.
+    *   @since Indev
+    */
+    upload_ticket open_streamed_texture(context&           context,
+                                        streamed_texture&  texture,
+                                        const std::string& path,
+                                        uint32_t           tail_size);
+
+    /*! @brief Destroys the images of a streamed texture once the GPU is done with them, and unmaps its file.
+    *   @memberof streamed_texture
+    *   @note Waits for a level upload still in flight.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] texture The streamed texture to close.
+    *   @since Indev
+    */
+    void close_streamed_texture(context&          context,
+                                streamed_texture& texture);
+
+    /*! @brief Requests the highest resolution mip level the renderer needs, clamped to the levels of the file.
+    *   @memberof streamed_texture
+    *   @param[in,out] texture The streamed texture to request from.
+    *   @param[in] mip The mip level wanted, 0 being the full resolution.
+    *   @since Indev
+    */
+    void request_texture_mip(streamed_texture& texture,
+                             uint32_t          mip);
+
+    /*! @brief Swaps in a finished upload, then starts streaming towards the requested level, or evicts the top level while memory is over pressure.
+    *   @memberof streamed_texture
+    *   @note Call once per frame before recording. Only one upload per texture is in flight at a time.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] texture The streamed texture to update.
+    *   @param[in] max_pressure The memory pressure, see @ref get_memory_pressure, above which levels are evicted rather than streamed in.
+    *   @return True if the image and its view were replaced, so descriptors referencing them must be rewritten.
+    *   @since Indev
+    */
+    bool update_streamed_texture(context&          context,
+                                 streamed_texture& texture,
+                                 float             max_pressure);
+
+//  ----- Render Targets -----
+
+    /*! @brief Creates a render target pool with a set of targets per frame in flight.
+    *   @memberof render_target_pool
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The render target pool to create and populate.
+    *   @param[in] frame_count The number of frames in flight.
+    *   @since Indev
+    */
+    void create_render_target_pool(const context&      context,
+                                   render_target_pool& pool,
+                                   uint32_t            frame_count);
+
+    /*! @brief Destroys every render target and its memory.
+    *   @memberof render_target_pool
+    *   @note The device must be idle.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The render target pool to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_render_target_pool(const context&      context,
+                                    render_target_pool& pool);
+
+    /*! @brief Starts gathering the render targets of a frame.
+    *   @memberof render_target_pool
+    *   @param[in,out] pool The render target pool to gather into.
+    *   @param[in] frame The index of the frame in flight.
+    *   @since Indev
+    */
+    void begin_render_targets(render_target_pool& pool,
+                              uint32_t            frame);
+
+    /*! @brief Requests a render target for the frame, used from the first to the last pass given.
+    *   @memberof render_target_pool
+    *   @note Targets are handed out with undefined contents, since their memory may have held another target earlier in the frame.
+    *   @param[in,out] pool The render target pool to request from.
+    *   @param[in] desc The shape of the render target.
+    *   @param[in] first_use The index of the first pass using the target.
+    *   @param[in] last_use The index of the last pass using the target.
+    *   @return The index of the target, see @ref get_render_target.
+    *   @since Indev
+    */
+    uint32_t request_render_target(render_target_pool&       pool,
+                                   const render_target_desc& desc,
+                                   uint32_t                  first_use,
+                                   uint32_t                  last_use);
+
+    /*! @brief Creates the images requested for the frame, reusing the previous ones when the requests have not changed.
+    *   @memberof render_target_pool
+    *   @note Call after @ref begin_frame, whose wait makes the frame's previous targets free to replace. Passes using aliased targets must still be ordered by barriers.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The render target pool to resolve.
+    *   @since Indev
+    */
+    void resolve_render_targets(const context&      context,
+                                render_target_pool& pool);
+
+    /*! @brief Returns a resolved render target of the current frame.
+    *   @memberof render_target_pool
+    *   @param[in] pool The render target pool the target was requested from.
+    *   @param[in] index The index returned by @ref request_render_target.
+    *   @return The image and view of the target.
+    *   @since Indev
+    */
+    const image& get_render_target(const render_target_pool& pool,
+                                   uint32_t                  index);
+
+//  ----- Barriers -----
+
+    /*! @brief Advances the tracked state of a resource to a new access, returning whether a barrier must come first.
+    *   @related resource_state
+    *   @note Reads after reads in the same layout need no barrier, unless they add a stage or an access type the earlier reads did not cover. Writes wait for every access since the last write.
+    *   @param[in,out] state The tracked state, left as it is after the access.
+    *   @param[in] next The access about to happen.
+    *   @param[in] discard True to discard the previous contents, transitioning from VK_IMAGE_LAYOUT_UNDEFINED.
+    *   @param[out] src_stages The stages the barrier waits for.
+    *   @param[out] src_access The writes the barrier makes available.
+    *   @param[out] old_layout The layout the barrier transitions from.
+    *   @return True if a barrier is needed.
+    *   @since Indev
+    */
+    bool advance_resource_state(resource_state&        state,
+                                const resource_access& next,
+                                bool                   discard,
+                                VkPipelineStageFlags2& src_stages,
+                                VkAccessFlags2&        src_access,
+                                VkImageLayout&         old_layout);
+
+    /*! @brief Gathers the barrier, if any, which an image needs before the given access, and tracks the access.
+    *   @memberof barrier_batch
+    *   @note Each resource may appear once per batch, since the barriers of one batch are unordered.
+    *   @param[in,out] batch The barrier batch to add to.
+    *   @param[in,out] img The image about to be accessed.
+    *   @param[in] next The access, whose layout every subresource is transitioned to.
+    *   @param[in] discard True if the previous contents are not needed.
+    *   @since Indev
+    */
+    void access_image(barrier_batch&         batch,
+                      image&                 img,
+                      const resource_access& next,
+                      bool                   discard = false);
+
+    /*! @brief Gathers the barrier, if any, which a buffer needs before the given access, and tracks the access.
+    *   @memberof barrier_batch
+    *   @note Each resource may appear once per batch, since the barriers of one batch are unordered.
+    *   @param[in,out] batch The barrier batch to add to.
+    *   @param[in,out] buf The buffer about to be accessed.
+    *   @param[in] next The access.
+    *   @since Indev
+    */
+    void access_buffer(barrier_batch&         batch,
+                       buffer&                buf,
+                       const resource_access& next);
+
+    /*! @brief Records raw image and buffer barriers in a single dependency.
+    *   @related command_buffer
+    *   @note Falls back to vkCmdPipelineBarrier with the union of the stage masks without synchronization2.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] command_buffer The command buffer to write the command to.
+    *   @param[in] image_barriers The image barriers.
+    *   @param[in] image_barrier_count The number of image barriers.
+    *   @param[in] buffer_barriers The buffer barriers.
+    *   @param[in] buffer_barrier_count The number of buffer barriers.
+    *   @since Indev
+    */
+    void record_barriers(const context&                context,
+                         const command_buffer&         command_buffer,
+                         const VkImageMemoryBarrier2*  image_barriers,
+                         uint32_t                      image_barrier_count,
+                         const VkBufferMemoryBarrier2* buffer_barriers,
+                         uint32_t                      buffer_barrier_count);
+
+    /*! @brief Records every gathered barrier in a single vkCmdPipelineBarrier2, then empties the batch.
+    *   @memberof barrier_batch
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] command_buffer The command buffer to write the command to.
+    *   @param[in,out] batch The barrier batch to flush.
+    *   @since Indev
+    */
+    void flush_barriers(const context&        context,
+                        const command_buffer& command_buffer,
+                        barrier_batch&        batch);
+
+//  ----- Render Graph -----
+
+    /*! @brief Starts declaring the passes of a frame, keeping the storage of the previous one.
+    *   @memberof render_graph
+    *   @param[in,out] graph The render graph to declare into.
+    *   @param[in,out] targets The pool transient images are requested from.
+    *   @param[in] frame The index of the frame in flight.
+    *   @since Indev
+    */
+    void begin_render_graph(render_graph&       graph,
+                            render_target_pool& targets,
+                            uint32_t            frame);
+
+    /*! @brief Adds an image from outside the graph, whose contents are kept.
+    *   @memberof render_graph
+    *   @note The first barrier starts from the tracked state of the image, which compiling the graph then advances.
+    *   @param[in,out] graph The render graph to add to.
+    *   @param[in,out] img The image, which must outlive the frame.
+    *   @param[in] final_layout The layout to leave the image in, such as VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, or VK_IMAGE_LAYOUT_UNDEFINED to leave it as used.
+    *   @return The resource.
+    *   @since Indev
+    */
+    graph_resource import_graph_image(render_graph& graph,
+                                      image&        img,
+                                      VkImageLayout final_layout);
+
+    /*! @brief Adds a buffer from outside the graph, whose contents are kept.
+    *   @memberof render_graph
+    *   @note The first barrier starts from the tracked state of the buffer, which compiling the graph then advances.
+    *   @param[in,out] graph The render graph to add to.
+    *   @param[in,out] buf The buffer, which must outlive the frame.
+    *   @return The resource.
+    *   @since Indev
+    */
+    graph_resource import_graph_buffer(render_graph& graph,
+                                       buffer&       buf);
+
+    /*! @brief Adds an image which only lives between its first and last pass, and may share memory with others.
+    *   @memberof render_graph
+    *   @param[in,out] graph The render graph to add to.
+    *   @param[in] desc The shape of the image.
+    *   @return The resource.
+    *   @since Indev
+    */
+    graph_resource create_graph_image(render_graph&             graph,
+                                      const render_target_desc& desc);
+
+    /*! @brief Adds a pass, whose uses are then declared with @ref use_graph_resource.
+    *   @memberof render_graph
+    *   @note Passes see the writes of the passes declared before them.
+    *   @param[in,out] graph The render graph to add to.
+    *   @param[in] name The name of the pass, which must outlive the frame.
+    *   @param[in] execute The function recording the pass.
+    *   @param[in] data Passed to the function.
+    *   @param[in] side_effect True to keep the pass even when nothing reads what it writes.
+    *   @return The index of the pass.
+    *   @since Indev
+    */
+    uint32_t add_graph_pass(render_graph& graph,
+                            const char*   name,
+                            graph_execute execute,
+                            void*         data,
+                            bool          side_effect = false);
+
+    /*! @brief Declares a use of a resource by the most recently added pass.
+    *   @memberof render_graph
+    *   @note Each resource may be used once per pass, so read-write uses have their own access.
+    *   @param[in,out] graph The render graph to declare into.
+    *   @param[in] resource The resource used.
+    *   @param[in] access How the pass uses it.
+    *   @param[in] stages The shader stages the access happens in, or 0 for every stage it may happen in.
+    *   @since Indev
+    */
+    void use_graph_resource(render_graph&         graph,
+                            graph_resource        resource,
+                            graph_access          access,
+                            VkPipelineStageFlags2 stages = 0);
+
+    /*! @brief Culls passes whose writes are never read, orders the rest, creates transient images and computes the barriers between passes.
+    *   @memberof render_graph
+    *   @note Advances the tracked state of imported resources as if the graph were already recorded, so it must be executed before they are used again.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] graph The render graph to compile.
+    *   @since Indev
+    */
+    void compile_render_graph(const context& context,
+                              render_graph&  graph);
+
+    /*! @brief Records the barriers and commands of every live pass in order.
+    *   @related render_graph
+    *   @note Render passes begun by a pass should keep attachments in the layout of their declared use.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in] graph The compiled render graph.
+    *   @since Indev
+    */
+    void execute_render_graph(const context&        context,
+                              const command_buffer& command_buffer,
+                              const render_graph&   graph);
+
+    /*! @brief Returns the image of a resource, valid once the graph is compiled.
+    *   @memberof render_graph
+    *   @param[in] graph The render graph.
+    *   @param[in] resource The image resource.
+    *   @return The image and its view.
+    *   @since Indev
+    */
+    const image& get_graph_image(const render_graph& graph,
+                                 graph_resource      resource);
+
+    /*! @brief Returns the buffer of an imported resource.
+    *   @memberof render_graph
+    *   @param[in] graph The render graph.
+    *   @param[in] resource The buffer resource.
+    *   @return The buffer.
+    *   @since Indev
+    */
+    const buffer& get_graph_buffer(const render_graph& graph,
+                                   graph_resource      resource);
+
+//  ----- Culling -----
+
+    /*! @brief Creates the buffers and culling pipeline for GPU-driven drawing of up to capacity objects.
+    *   @memberof gpu_culling
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] culling The culling state to create.
+    *   @param[in] capacity The maximum number of objects.
+    *   @param[in] shader_path The path of the compiled cull.comp shader.
+    *   @since Indev
+    */
+    void create_gpu_culling(const context&     context,
+                            gpu_culling&       culling,
+                            uint32_t           capacity,
+                            const std::string& shader_path);
+
+    /*! @brief Destroys the buffers and pipeline of the culling state.
+    *   @memberof gpu_culling
     *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] culling The culling state to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_gpu_culling(const context& context,
+                             gpu_culling&   culling);
+
+    /*! @brief Fills the culling record of a mesh from the geometry pool, for one instance per visible object.
+    *   @related gpu_object
+    *   @param[in] mesh The mesh drawn for the object.
+    *   @param[in] center The centre of the bounding sphere.
+    *   @param[in] radius The radius of the bounding sphere.
+    *   @return The culling record.
+    *   @since Indev
+    */
+    gpu_object make_gpu_object(const mesh_range& mesh,
+                               const glm::vec3&  center,
+                               float             radius);
+
+    /*! @brief Queues new records for a range of objects on the context upload manager.
+    *   @memberof gpu_culling
+    *   @note Objects past the last one written are not culled or drawn.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] culling The culling state to write to.
+    *   @param[in] first The first object to write.
+    *   @param[in] count The number of objects to write.
+    *   @param[in] objects The object records.
+    *   @return A ticket for the batch the upload was recorded into.
+    *   @since Indev
+    */
+    upload_ticket write_gpu_objects(context&          context,
+                                    gpu_culling&      culling,
+                                    uint32_t          first,
+                                    uint32_t          count,
+                                    const gpu_object* objects);
+
+    /*! @brief Records the culling pass, which must come before the render pass drawing its results.
+    *   @related gpu_culling
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in] culling The culling state.
+    *   @param[in] view_projection The matrix the object bounds are culled with, using a 0 to 1 depth range.
+    *   @since Indev
+    */
+    void record_gpu_culling(const command_buffer& command_buffer,
+                            const gpu_culling&    culling,
+                            const glm::mat4&      view_projection);
+
+    /*! @brief Draws every object which passed the culling pass, using the bound pipeline and geometry pool.
+    *   @related gpu_culling
+    *   @note When the device supports multiDrawIndirect, the first instance of each draw is the index of its object, so shaders can fetch per object data.
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in] culling The culling state.
+    *   @since Indev
+    */
+    void draw_gpu_culled(const command_buffer& command_buffer,
+                         const gpu_culling&    culling);
+
+//  ----- Profiling -----
+
+    /*! @brief Creates the query pools of a GPU profiler, one set per frame in flight.
+    *   @memberof gpu_profiler
+    *   @note Pipeline statistics are left out when the device does not support them.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[out] profiler The profiler to create.
+    *   @param[in] frame_count The number of frames in flight, which is also how many frames late results are resolved.
+    *   @param[in] max_scopes The most scopes timed per frame.
+    *   @param[in] pipeline_statistics True to also collect pipeline statistics for top level scopes.
+    *   @since Indev
+    */
+    void create_gpu_profiler(const context& context,
+                             gpu_profiler&  profiler,
+                             uint32_t       frame_count,
+                             uint32_t       max_scopes,
+                             bool           pipeline_statistics = false);
+
+    /*! @brief Destroys the query pools of a GPU profiler.
+    *   @memberof gpu_profiler
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] profiler The profiler to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_gpu_profiler(const context& context,
+                              gpu_profiler&  profiler);
+
+    /*! @brief Resolves the frame last recorded in this frame in flight, then resets its queries for the new frame.
+    *   @memberof gpu_profiler
+    *   @note Call after @ref begin_frame and outside a render pass. Results not yet available, which the wait of @ref begin_frame makes rare, are dropped rather than waited for.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] profiler The profiler.
+    *   @param[in] command_buffer The command buffer of the frame, recording.
+    *   @param[in] frame The index of the current frame in flight.
+    *   @param[in] frame_number The number of the frame being recorded.
+    *   @since Indev
+    */
+    void begin_gpu_profiler_frame(const context&        context,
+                                  gpu_profiler&         profiler,
+                                  const command_buffer& command_buffer,
+                                  uint32_t              frame,
+                                  uint64_t              frame_number);
+
+    /*! @brief Opens a named scope, timed from when earlier commands have started.
+    *   @memberof gpu_profiler
+    *   @note Top level scopes collecting pipeline statistics must begin and end on the same side of a render pass instance.
+    *   @param[in,out] profiler The profiler.
+    *   @param[in] command_buffer The command buffer to write the queries to.
+    *   @param[in] name The name of the scope, which must outlive the profiler, such as a string literal.
+    *   @since Indev
+    */
+    void begin_gpu_scope(gpu_profiler&         profiler,
+                         const command_buffer& command_buffer,
+                         const char*           name);
+
+    /*! @brief Closes the innermost open scope, timed until earlier commands have finished.
+    *   @memberof gpu_profiler
+    *   @param[in,out] profiler The profiler.
+    *   @param[in] command_buffer The command buffer to write the queries to.
+    *   @since Indev
+    */
+    void end_gpu_scope(gpu_profiler&         profiler,
+                       const command_buffer& command_buffer);
+
+    /*! @brief Returns the GPU time of every scope with a name in the last resolved frame.
+    *   @memberof gpu_profiler
+    *   @param[in] profiler The profiler.
+    *   @param[in] name The name of the scope, compared by content.
+    *   @return The summed duration in milliseconds, 0 if no scope had the name.
+    *   @since Indev
+    */
+    double get_gpu_scope_ms(const gpu_profiler& profiler,
+                            const char*         name);
+
+    /*! @brief Returns the GPU time from the start of the first top level scope to the end of the last in the last resolved frame.
+    *   @memberof gpu_profiler
+    *   @param[in] profiler The profiler.
+    *   @return The duration in milliseconds, 0 before a frame is resolved.
+    *   @since Indev
+    */
+    double get_gpu_frame_ms(const gpu_profiler& profiler);
+
+    /*! @brief Starts or stops keeping every resolved scope for @ref write_gpu_trace.
+    *   @memberof gpu_profiler
+    *   @param[in,out] profiler The profiler.
+    *   @param[in] capture True to start capturing, which discards the previous capture.
+    *   @since Indev
+    */
+    void capture_gpu_trace(gpu_profiler& profiler,
+                           bool          capture);
+
+    /*! @brief Writes the captured scopes, followed by the CPU zones of the last trace capture, as a Chrome trace_event JSON file.
+    *   @memberof gpu_profiler
+    *   @note Events are in microseconds on the CPU steady clock when timestamps are calibrated, so they line up with the CPU zones.
+    *   @param[in] profiler The profiler.
+    *   @param[in] path The file to write.
+    *   @return True if the file was written.
+    *   @since Indev
+    */
+    bool write_gpu_trace(const gpu_profiler& profiler,
+                         const std::string&  path);
+
+//  ----- Deletion -----
+
+    /*! @brief Destroys the objects released during the last use of the given frame, and makes it the current bucket.
+    *   @memberof deletion_queue
+    *   @note Called by @ref begin_frame once the frame's previous submit has finished.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] deletions The deletion queue to flush.
+    *   @param[in] frame The index of the frame in flight.
+    *   @since Indev
+    */
+    void flush_deletion_queue(const context&  context,
+                              deletion_queue& deletions,
+                              uint32_t        frame);
+
+    /*! @brief Destroys a buffer once the frames in flight that may use it have completed, and empties the wrapper.
+    *   @memberof buffer
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] buf The buffer wrapper to release.
+    *   @since Indev
+    */
+    void defer_destroy_buffer(context& context,
+                              buffer&  buf);
+
+    /*! @brief Destroys an image once the frames in flight that may use it have completed, and empties the wrapper.
+    *   @memberof image
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] img The image wrapper to release.
+    *   @since Indev
+    */
+    void defer_destroy_image(context& context,
+                             image&   img);
+
+    /*! @brief Destroys a pipeline once the frames in flight that may use it have completed, and empties the wrapper.
+    *   @memberof pipeline
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] pipeline The pipeline wrapper to release.
+    *   @since Indev
+    */
+    void defer_destroy_pipeline(context&  context,
+                                pipeline& pipeline);
+
+    /*! @brief Destroys a framebuffer once the frames in flight that may use it have completed, and empties the wrapper.
+    *   @memberof framebuffer
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] framebuffer The framebuffer wrapper to release.
+    *   @since Indev
+    */
+    void defer_destroy_framebuffer(context&     context,
+                                   framebuffer& framebuffer);
+
+    /*! @brief Returns a mesh range to its geometry pool once the frames in flight that may draw it have completed, and empties the range.
+    *   @related geometry_pool
+    *   @note Used by @ref free_mesh, so an allocation made meanwhile cannot reuse a range the GPU still reads.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] pool The geometry pool the mesh was allocated from, which must outlive the deferral.
+    *   @param[in,out] mesh The range to release.
+    *   @since Indev
+    */
+    void defer_free_mesh(context&       context,
+                         geometry_pool& pool,
+                         mesh_range&    mesh);
+
+//  ----- Generic -----
+
+    /*! @brief Allocates a device local buffer and queues its data on the context upload manager.
+    *   @memberof buffer
+    *   @note The buffer must not be read until the returned ticket completes, see @ref is_upload_complete and @ref wait_for_upload. Pending uploads are flushed by @ref end_frame.
+    *   @param[in,out] context The associated vulkan context wrapper.
     *   @param[in,out] buf The buffer wrapper to allocate and store to.
     *   @param[in] size The amount of bytes to allocate and store.
     *   @param[in] usage The VkBufferUsageFlags to specify the usages of the buffer.
-    *   @param[in] memory_props The properties of the memory allocated.
+    *   @param[in] input_data The data to upload, copied into the staging ring before returning.
+    *   @return A ticket for the batch the upload was recorded into.
     *   @since Indev
     */
-    void create_staged_buffer(const context&     context,
-                              buffer&            buffer,
-                              VkDeviceSize       size,
-                              VkBufferUsageFlags usage,
-                              const void*        input_data);
+    upload_ticket create_staged_buffer(context&           context,
+                                       buffer&            buffer,
+                                       VkDeviceSize       size,
+                                       VkBufferUsageFlags usage,
+                                       const void*        input_data);
 
     /*! @brief Allocates an empty buffer.
     *   @memberof buffer
@@ -387,7 +2270,22 @@ namespace poly::vk
                        VkBufferUsageFlags    usage,
                        VkMemoryPropertyFlags memory_props);
 
-    /*! @brief Stores data to a pre-allocated buffer.
+    /*! @brief Allocates an empty buffer which stays mapped for its lifetime.
+    *   @memberof buffer
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] buf The buffer wrapper to allocate for.
+    *   @param[in] size The amount of bytes to allocate for.
+    *   @param[in] usage The VkBufferUsageFlags to specify the usages of the buffer.
+    *   @param[in] memory_props The properties of the memory allocated, which must include VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT. Readback buffers should also request VK_MEMORY_PROPERTY_HOST_CACHED_BIT.
+    *   @since Indev
+    */
+    void create_mapped_buffer(const context&        context,
+                              buffer&               buf,
+                              VkDeviceSize          size,
+                              VkBufferUsageFlags    usage,
+                              VkMemoryPropertyFlags memory_props);
+
+    /*! @brief Stores data to a pre-allocated buffer, filling its whole size.
     *   @memberof buffer
     *   @param[in] context The associated vulkan context wrapper.
     *   @param[in] buf The buffer wrapper containing the memory handle to write to.
@@ -398,6 +2296,89 @@ namespace poly::vk
                       const buffer&  buf,
                       const void*    data);
 
+    /*! @brief Writes a range of a host visible buffer, flushing it if the memory is not coherent.
+    *   @memberof buffer
+    *   @note Persistently mapped buffers are written directly, others are mapped for the duration of the call.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] buf The buffer wrapper to write to.
+    *   @param[in] data The data to write.
+    *   @param[in] offset The byte offset into the buffer.
+    *   @param[in] size The amount of bytes to write.
+    *   @since Indev
+    */
+    void write_buffer(const context& context,
+                      const buffer&  buf,
+                      const void*    data,
+                      VkDeviceSize   offset,
+                      VkDeviceSize   size);
+
+    /*! @brief Reads a range of a host visible buffer, invalidating it first if the memory is not coherent.
+    *   @memberof buffer
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] buf The buffer wrapper to read from.
+    *   @param[out] data The memory to read into.
+    *   @param[in] offset The byte offset into the buffer.
+    *   @param[in] size The amount of bytes to read.
+    *   @since Indev
+    */
+    void read_buffer(const context& context,
+                     const buffer&  buf,
+                     void*          data,
+                     VkDeviceSize   offset,
+                     VkDeviceSize   size);
+
+    /*! @brief Adds a buffer to buffer copy region to a copy batch.
+    *   @memberof copy_batch
+    *   @param[in,out] batch The copy batch to add to.
+    *   @param[in] src The buffer to copy from.
+    *   @param[in] dst The buffer to copy to.
+    *   @param[in] src_offset The byte offset into the source buffer.
+    *   @param[in] dst_offset The byte offset into the destination buffer.
+    *   @param[in] size The amount of bytes to copy.
+    *   @since Indev
+    */
+    void add_buffer_copy(copy_batch&  batch,
+                         VkBuffer     src,
+                         VkBuffer     dst,
+                         VkDeviceSize src_offset,
+                         VkDeviceSize dst_offset,
+                         VkDeviceSize size);
+
+    /*! @brief Adds a buffer to image copy region to a copy batch.
+    *   @memberof copy_batch
+    *   @param[in,out] batch The copy batch to add to.
+    *   @param[in] src The buffer to copy from.
+    *   @param[in] dst The image to copy to.
+    *   @param[in] dst_layout The layout the image will be in when the batch executes.
+    *   @param[in] region The region to copy.
+    *   @since Indev
+    */
+    void add_buffer_image_copy(copy_batch&              batch,
+                               VkBuffer                 src,
+                               VkImage                  dst,
+                               VkImageLayout            dst_layout,
+                               const VkBufferImageCopy& region);
+
+    /*! @brief Records every region of a copy batch, grouped by destination with neighbouring regions merged, and empties the batch.
+    *   @related copy_batch
+    *   @note Must be recorded outside a render pass. Buffer copies to a destination keep the order they were added in, and ones overlapping an earlier copy are recorded after a barrier. Barriers around the copies are left to the caller.
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in,out] batch The copy batch to record.
+    *   @since Indev
+    */
+    void record_copy_batch(const command_buffer& command_buffer,
+                           copy_batch&           batch);
+
+    /*! @brief Records a copy batch into a single command buffer, submits it to the graphics queue and waits for it to complete.
+    *   @memberof copy_batch
+    *   @note The copies are ordered after all previously submitted work and made visible to all later work.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] batch The copy batch to execute.
+    *   @since Indev
+    */
+    void submit_copy_batch(const context& context,
+                           copy_batch&    batch);
+
     /*! @brief Copies data from one buffer handle to another.
     *   @memberof buffer
     *   @param[in] context The associated vulkan context wrapper.
@@ -444,17 +2425,36 @@ namespace poly::vk
     void destroy_framebuffer(const context& context,
                              framebuffer& framebuffer);
                  
-    /*! @brief Creates a vulkan image and stores it in the image wrapper.
+    /*! @brief Creates a vulkan image backed by a VMA allocation and stores it in the image wrapper.
     *   @memberof image
     *   @param[in] context The associated vulkan context wrapper.
     *   @param[in,out] img The image wrapper to store the image in.
-    *   @todo Implement.
+    *   @param[in] cfg The configuration of the image.
     *   @since Indev
     */
-    void create_image(const context& context,
-                      image&         img); // TODO: implement
+    void create_image(const context&   context,
+                      image&           img,
+                      const image_cfg& cfg);
 
-    /*! @brief Creates a view to an image with a given format and flag settings.
+    /*! @brief Creates a sampled texture, queues its top level on the context upload manager and generates the rest of its mip chain on the GPU.
+    *   @memberof image
+    *   @note The texture must not be sampled until the returned ticket completes. Its view covers every mip level and array layer.
+    *   @note A default mip count falls back to the top level alone for formats without blit support, see @ref supports_mip_generation.
+    *   @param[in,out] context The associated vulkan context wrapper.
+    *   @param[in,out] img The image wrapper to create and populate.
+    *   @param[in] cfg The configuration of the texture, see @ref image_cfg::texture.
+    *   @param[in] size The amount of bytes of texel data, covering every array layer of the top mip level.
+    *   @param[in] data The tightly packed texel data of the top mip level, layer after layer.
+    *   @return A ticket for the batch the upload was recorded into.
+    *   @since Indev
+    */
+    upload_ticket create_texture(context&         context,
+                                 image&           img,
+                                 const image_cfg& cfg,
+                                 VkDeviceSize     size,
+                                 const void*      data);
+
+    /*! @brief Creates a view to an image with a given format and flag settings, covering every mip level and array layer of the image.
     *   @memberof image
     *   @param[in] context The associated vulkan context wrapper.
     *   @param[in,out] img The image wrapper to store the image view in.
@@ -509,12 +2509,14 @@ namespace poly::vk
     *   @param[in] render_pass The render pass to begin.
     *   @param[in] framebuffer The framebuffer to write to.
     *   @param[in] extend The render extent (dimensions).
+    *   @param[in] contents VK_SUBPASS_CONTENTS_INLINE to record draws directly, or VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS to execute secondary command buffers.
     *   @since Indev
     */
     void begin_render_pass(const command_buffer& command_buffer,
                            VkRenderPass          render_pass,
                            const framebuffer&    framebuffer,
-                           const VkExtent2D&     extent);
+                           const VkExtent2D&     extent,
+                           VkSubpassContents     contents);
 
     /*! @brief Ends the render pass.
     *   @related command_buffer
@@ -523,8 +2525,293 @@ namespace poly::vk
     */
     void end_render_pass(const command_buffer& command_buffer);
 
+    /*! @brief Creates a command pool for every recording thread and frame in flight.
+    *   @memberof thread_command_pools
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pools The thread command pools to create and populate.
+    *   @param[in] thread_count The number of threads recording, matching the worker pool.
+    *   @param[in] frame_count The number of frames in flight.
+    *   @since Indev
+    */
+    void create_thread_command_pools(const context&        context,
+                                     thread_command_pools& pools,
+                                     uint32_t              thread_count,
+                                     uint32_t              frame_count);
+
+    /*! @brief Destroys every thread command pool and the command buffers allocated from them.
+    *   @memberof thread_command_pools
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pools The thread command pools to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_thread_command_pools(const context&        context,
+                                      thread_command_pools& pools);
+
+    /*! @brief Resets the command pools of a frame, recycling every secondary command buffer recorded from them.
+    *   @memberof thread_command_pools
+    *   @note Call after @ref begin_frame, whose fence wait guarantees the frame's command buffers have finished executing.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pools The thread command pools to reset.
+    *   @param[in] frame The index of the frame in flight.
+    *   @since Indev
+    */
+    void reset_thread_command_pools(const context&        context,
+                                    thread_command_pools& pools,
+                                    uint32_t              frame);
+
+    /*! @brief Begins a secondary command buffer from a thread's pool, inheriting a subpass of a render pass and its framebuffer.
+    *   @memberof thread_command_pools
+    *   @note Only the given thread may call this with its index. Dynamic state, such as the viewport, is not inherited and must be set again.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pools The thread command pools to allocate from.
+    *   @param[in] thread The index of the calling thread.
+    *   @param[in] render_pass The render pass the secondary executes within.
+    *   @param[in] subpass The subpass the secondary executes within.
+    *   @param[in] framebuffer The framebuffer the render pass was begun with.
+    *   @return The secondary command buffer, ready to record into.
+    *   @since Indev
+    */
+    command_buffer begin_secondary_commands(const context&        context,
+                                            thread_command_pools& pools,
+                                            uint32_t              thread,
+                                            VkRenderPass          render_pass,
+                                            uint32_t              subpass,
+                                            const framebuffer&    framebuffer);
+
+    /*! @brief Executes secondary command buffers from a primary one.
+    *   @related command_buffer
+    *   @param[in] command_buffer The primary command buffer, within a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    *   @param[in] secondaries The secondary command buffers to execute, in order.
+    *   @param[in] count The number of secondary command buffers.
+    *   @since Indev
+    */
+    void execute_secondary_commands(const command_buffer&  command_buffer,
+                                    const VkCommandBuffer* secondaries,
+                                    uint32_t               count);
+
+    /*! @brief Splits a draw list into one contiguous range per thread, records each into a secondary command buffer in parallel, and executes them in order.
+    *   @related thread_command_pools
+    *   @note The primary must be within a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] workers The worker pool to record on.
+    *   @param[in,out] pools The thread command pools to record from, created with the worker pool thread count.
+    *   @param[in] primary The primary command buffer to execute the secondaries from.
+    *   @param[in] render_pass The render pass the primary is within.
+    *   @param[in] subpass The current subpass of the render pass.
+    *   @param[in] framebuffer The framebuffer the render pass was begun with.
+    *   @param[in] draw_count The number of draws in the list.
+    *   @param[in] record A callable taking the secondary command buffer, the first draw and the end of the range to record.
+    *   @since Indev
+    */
+    template <typename F>
+    void record_parallel(const context&        context,
+                         poly::worker_pool&    workers,
+                         thread_command_pools& pools,
+                         const command_buffer& primary,
+                         VkRenderPass          render_pass,
+                         uint32_t              subpass,
+                         const framebuffer&    framebuffer,
+                         uint32_t              draw_count,
+                         F&                    record)
+    {
+        const uint32_t ranges = draw_count < pools.thread_count ? draw_count : pools.thread_count;
+        pools.recorded.resize(ranges);
+
+        auto job = [&](uint32_t range, uint32_t thread)
+        {
+            const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(draw_count) * range / ranges);
+            const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(draw_count) * (range + 1) / ranges);
+
+            command_buffer secondary = begin_secondary_commands(context, pools, thread, render_pass, subpass, framebuffer);
+            record(secondary, first, end);
+            end_recording_commands(secondary);
+            pools.recorded[range] = secondary.buf;
+        };
+        poly::dispatch_jobs(workers, ranges, job);
+
+        execute_secondary_commands(primary, pools.recorded.data(), ranges);
+    }
+
+    /*! @brief Packs a sort key which groups draws by layer, then pipeline, then material, then depth.
+    *   @related draw_packet
+    *   @param[in] layer The coarse ordering, such as opaque before transparent, in the top 8 bits.
+    *   @param[in] pipeline_id The pipeline, in the next 16 bits.
+    *   @param[in] material_id The descriptor sets or material, in the next 16 bits.
+    *   @param[in] depth The quantised depth in the low 24 bits, inverted by the caller for back to front ordering.
+    *   @return The sort key.
+    *   @since Indev
+    */
+    uint64_t make_sort_key(uint8_t  layer,
+                           uint16_t pipeline_id,
+                           uint16_t material_id,
+                           uint32_t depth);
+
+    /*! @brief Adds a draw packet to a render queue, copying its push constants.
+    *   @memberof render_queue
+    *   @param[in,out] queue The render queue to add to.
+    *   @param[in] packet The draw packet.
+    *   @param[in] push_constants The push constants, packet.push_size bytes long, or nullptr when there are none.
+    *   @since Indev
+    */
+    void submit_draw(render_queue&      queue,
+                     const draw_packet& packet,
+                     const void*        push_constants);
+
+    /*! @brief Radix sorts the packets of a render queue by key, stable for equal keys.
+    *   @memberof render_queue
+    *   @param[in,out] queue The render queue to sort.
+    *   @since Indev
+    */
+    void sort_render_queue(render_queue& queue);
+
+    /*! @brief Records a range of a sorted render queue, skipping binds and push constants which match the draw before.
+    *   @related render_queue
+    *   @note Ranges are independent, so they can be recorded into separate secondary command buffers, see @ref record_parallel.
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in] queue The sorted render queue.
+    *   @param[in] first The first draw, in sorted order.
+    *   @param[in] end The end of the range, in sorted order.
+    *   @return The state changes recorded and skipped.
+    *   @since Indev
+    */
+    render_queue_stats record_render_queue(const command_buffer& command_buffer,
+                                           const render_queue&   queue,
+                                           uint32_t              first,
+                                           uint32_t              end);
+
+    /*! @brief Sorts and records every packet of a render queue, then empties it for the next frame.
+    *   @related render_queue
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in,out] queue The render queue to flush.
+    *   @return The state changes recorded and skipped.
+    *   @since Indev
+    */
+    render_queue_stats flush_render_queue(const command_buffer& command_buffer,
+                                          render_queue&         queue);
+
+    /*! @brief Empties a render queue, keeping its storage.
+    *   @memberof render_queue
+    *   @param[in,out] queue The render queue to clear.
+    *   @since Indev
+    */
+    void clear_render_queue(render_queue& queue);
+
+    /*! @brief Creates a command pool on the compute queue family, with a command buffer per frame in flight, and the compute timeline.
+    *   @memberof async_compute
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] compute The async compute state to create.
+    *   @param[in] frame_count The number of frames in flight.
+    *   @since Indev
+    */
+    void create_async_compute(const context& context,
+                              async_compute& compute,
+                              uint32_t       frame_count);
+
+    /*! @brief Destroys the command pool and synchronisation objects of the async compute state.
+    *   @memberof async_compute
+    *   @note The compute queue must be idle.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] compute The async compute state to destroy the contents of.
+    *   @since Indev
+    */
+    void destroy_async_compute(const context& context,
+                               async_compute& compute);
+
+    /*! @brief Waits for the compute work of the frame slot to finish, then begins recording its command buffer again.
+    *   @memberof async_compute
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] compute The async compute state.
+    *   @param[in] frame The index of the current frame in flight.
+    *   @return The command buffer to record compute work into.
+    *   @since Indev
+    */
+    command_buffer begin_async_compute(const context& context,
+                                       async_compute& compute,
+                                       uint32_t       frame);
+
+    /*! @brief Submits the recorded compute work to the compute queue, ahead of the graphics work of the frame.
+    *   @memberof async_compute
+    *   @note The graphics submit of the next @ref end_frame waits for it, when the draw state context points at this state.
+    *   @note Waits for the last graphics submit, which may still read the outputs of the previous compute work. Outputs which later compute work reads back must also be handed back, see @ref record_compute_handback.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] compute The async compute state.
+    *   @param[in] graphics The graphics timeline of the frames reading the results, see @ref synchron.
+    *   @param[in] graphics_wait_stages The graphics stages which read the results of the compute work.
+    *   @since Indev
+    */
+    void submit_async_compute(const context&        context,
+                              async_compute&        compute,
+                              const queue_timeline& graphics,
+                              VkPipelineStageFlags  graphics_wait_stages);
+
+    /*! @brief Records the transfer of a buffer written by compute work to the graphics queue family.
+    *   @related async_compute
+    *   @note Records nothing when both queues share a family, where the semaphore alone orders the work.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] compute The async compute state.
+    *   @param[in] compute_cmd The compute command buffer, which releases the buffer after writing it.
+    *   @param[in] graphics_cmd The graphics command buffer, which acquires the buffer before reading it.
+    *   @param[in] buf The buffer to hand over.
+    *   @param[in] dst_stages The graphics stages which read the buffer.
+    *   @param[in] dst_access The access the graphics stages read the buffer with.
+    *   @since Indev
+    */
+    void record_compute_handoff(const context&        context,
+                                const async_compute&  compute,
+                                const command_buffer& compute_cmd,
+                                const command_buffer& graphics_cmd,
+                                const buffer&         buf,
+                                VkPipelineStageFlags  dst_stages,
+                                VkAccessFlags         dst_access);
+
+    /*! @brief Records the transfer of a buffer read by graphics work back to the compute queue family, for compute work which reads its previous results.
+    *   @related async_compute
+    *   @note Records nothing when both queues share a family. Buffers the compute work overwrites whole need no transfer, as the wait of @ref submit_async_compute orders the writes after the reads.
+    *   @note The acquire must only be submitted after a graphics submit holding the release, so the first frame skips it.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] compute The async compute state.
+    *   @param[in] graphics_cmd The graphics command buffer, which releases the buffer after reading it.
+    *   @param[in] compute_cmd The compute command buffer of the next frame, which acquires the buffer before writing it.
+    *   @param[in] buf The buffer to hand back.
+    *   @param[in] src_stages The graphics stages which read the buffer.
+    *   @since Indev
+    */
+    void record_compute_handback(const context&        context,
+                                 const async_compute&  compute,
+                                 const command_buffer& graphics_cmd,
+                                 const command_buffer& compute_cmd,
+                                 const buffer&         buf,
+                                 VkPipelineStageFlags  src_stages);
+
+    /*! @brief Binds a compute pipeline and dispatches enough workgroups to cover the given number of invocations.
+    *   @related command_buffer
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in] pipeline The compute pipeline to dispatch.
+    *   @param[in] threads The number of invocations in each dimension.
+    *   @param[in] group_size The local size of the shader in each dimension.
+    *   @since Indev
+    */
+    void dispatch_compute(const command_buffer& command_buffer,
+                          const pipeline&       pipeline,
+                          const VkExtent3D&     threads,
+                          const VkExtent3D&     group_size);
+
+    /*! @brief Binds a compute pipeline and dispatches the workgroup counts held by a buffer, as written by an earlier pass.
+    *   @related command_buffer
+    *   @param[in] command_buffer The command buffer to write the commands to.
+    *   @param[in] pipeline The compute pipeline to dispatch.
+    *   @param[in] args The buffer holding a VkDispatchIndirectCommand, created with VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT.
+    *   @param[in] offset The byte offset of the command in the buffer.
+    *   @since Indev
+    */
+    void dispatch_compute_indirect(const command_buffer& command_buffer,
+                                   const pipeline&       pipeline,
+                                   const buffer&         args,
+                                   VkDeviceSize          offset);
+
     /*! @brief Acquires the next image from the swapchain to begin the next frame.
     *   @related draw_state_context
+    *   @note First waits on the graphics timeline for the last frame submitted from the same frame in flight.
     *   @param[in,out] context The associated vulkan context wrapper.
     *   @param[in,out] draw_state_context The struct holding relevant information and state used to draw a frame.
     *   @since Indev
@@ -534,6 +2821,7 @@ namespace poly::vk
 
     /*! @brief Submits the queue and presents the produced image.
     *   @related draw_state_context
+    *   @note The submit signals the graphics timeline to @ref synchron::frame_number, which then advances.
     *   @param[in,out] context The associated vulkan context wrapper.
     *   @param[in,out] draw_state_context The struct holding relevant information and state used to draw a frame.
     *   @since Indev
@@ -545,7 +2833,7 @@ namespace poly::vk
     *   @memberof synchron
     *   @param[in] context The associated vulkan context wrapper.
     *   @param[in,out] sync The sync object wrapper to create and populate.
-    *   @param[in] max_syncs The number of each type of semaphore and fence to create.
+    *   @param[in] max_syncs The number of frames in flight, each with its own image acquire semaphore.
     *   @since Indev
     */
     void create_synchron(const context& context,
@@ -561,6 +2849,127 @@ namespace poly::vk
     void destroy_synchron(const context& context,
                           synchron&      sync);
 
+    /*! @brief Returns the frame number of the last frame whose graphics work has finished on the GPU.
+    *   @memberof synchron
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] sync The sync object of the frames.
+    *   @return The frame number, or 0 before any frame has finished.
+    *   @since Indev
+    */
+    uint64_t get_finished_frame(const context&  context,
+                                const synchron& sync);
+
+    /*! @brief Checks without blocking whether the graphics work of a frame has finished on the GPU.
+    *   @memberof synchron
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] sync The sync object of the frames.
+    *   @param[in] frame_number The frame number, as in @ref synchron::frame_number when it was recorded.
+    *   @return True if the frame has finished.
+    *   @since Indev
+    */
+    bool is_frame_finished(const context&  context,
+                           const synchron& sync,
+                           uint64_t        frame_number);
+
+    /*! @brief Blocks until the graphics work of a frame has finished on the GPU.
+    *   @memberof synchron
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] sync The sync object of the frames.
+    *   @param[in] frame_number The frame number, which must already be submitted.
+    *   @since Indev
+    */
+    void wait_for_frame(const context&  context,
+                        const synchron& sync,
+                        uint64_t        frame_number);
+
+    /*! @brief Records the latency of every frame whose GPU work or present has been seen to finish since the last call.
+    *   @memberof frame_latency
+    *   @note Called by @ref begin_frame, so latencies are observed to within the time between frames.
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] sync The sync object of the frames, holding the latency.
+    *   @since Indev
+    */
+    void update_frame_latency(const context& context,
+                              synchron&      sync);
+
+    /*! @brief Records the time a frame is submitted at.
+    *   @memberof frame_latency
+    *   @note Called by @ref end_frame.
+    *   @param[in,out] latency The frame latency to record into.
+    *   @param[in] frame_number The frame being submitted.
+    *   @since Indev
+    */
+    void mark_frame_submitted(frame_latency& latency,
+                              uint64_t       frame_number);
+
+    /*! @brief Stops waiting for presents which can no longer be observed, such as those to a destroyed swapchain.
+    *   @memberof frame_latency
+    *   @param[in,out] latency The frame latency.
+    *   @param[in] frame_number The first frame whose present is observed.
+    *   @since Indev
+    */
+    void skip_frame_presents(frame_latency& latency,
+                             uint64_t       frame_number);
+
+    /*! @brief Clears the latency statistics, for example after switching present policy.
+    *   @memberof frame_latency
+    *   @param[in,out] latency The frame latency to reset.
+    *   @since Indev
+    */
+    void reset_frame_latency(frame_latency& latency);
+
+    /*! @brief Creates a timeline semaphore starting at 0.
+    *   @memberof queue_timeline
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[out] timeline The timeline to create.
+    *   @since Indev
+    */
+    void create_queue_timeline(const context&  context,
+                               queue_timeline& timeline);
+
+    /*! @brief Destroys the semaphore of a timeline, which must not have pending submits.
+    *   @memberof queue_timeline
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] timeline The timeline to destroy.
+    *   @since Indev
+    */
+    void destroy_queue_timeline(const context&  context,
+                                queue_timeline& timeline);
+
+    /*! @brief Advances the value the next submit of the timeline's queue signals.
+    *   @memberof queue_timeline
+    *   @param[in,out] timeline The timeline to advance.
+    *   @param[in] value The value to signal, which must be greater than the last, or 0 for the one after it.
+    *   @return The value to signal.
+    *   @since Indev
+    */
+    uint64_t next_timeline_value(queue_timeline& timeline,
+                                 uint64_t        value = 0);
+
+    /*! @brief Returns the value the GPU has signalled a timeline to so far.
+    *   @memberof queue_timeline
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] timeline The timeline to query.
+    *   @return The signalled value.
+    *   @since Indev
+    */
+    uint64_t get_timeline_value(const context&        context,
+                                const queue_timeline& timeline);
+
+    /*! @brief Blocks until a timeline reaches a value, or the timeout passes.
+    *   @memberof queue_timeline
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] timeline The timeline to wait on.
+    *   @param[in] value The value to wait for, which must already be submitted.
+    *   @param[in] timeout The timeout in nanoseconds, 0 to poll.
+    *   @return True if the value was reached.
+    *   @since Indev
+    */
+    bool wait_timeline(const context&        context,
+                       const queue_timeline& timeline,
+                       uint64_t              value,
+                       uint64_t              timeout = UINT64_MAX);
+
     /*! @brief Creates a vulkan rasterization pipeline using the provided configuration.
     *   @related pipeline
     *   @param[in] context The associated vulkan context wrapper.
@@ -572,6 +2981,44 @@ namespace poly::vk
                                   pipeline&               pipeline,
                                   const gfx_pipeline_cfg& spec);                  
 
+    /*! @brief Returns the aspects of an image with the given format.
+    *   @related image
+    *   @param[in] format The format of the image.
+    *   @return The depth and stencil aspects of depth stencil formats, the colour aspect otherwise.
+    *   @since Indev
+    */
+    VkImageAspectFlags get_format_aspect(VkFormat format);
+
+    /*! @brief Returns the texel block of a format, used to lay out its data in buffers.
+    *   @related image
+    *   @note Combined depth stencil formats are copied an aspect at a time, so they report a size of 0.
+    *   @param[in] format The format of the image.
+    *   @return The block extent and size in bytes, a size of 0 for unsupported formats.
+    *   @since Indev
+    */
+    format_block get_format_block(VkFormat format);
+
+    /*! @brief Returns whether the mip chain of an image with the given format can be generated by blits.
+    *   @related image
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in] format The format of the image.
+    *   @return Whether optimally tiled images of the format support being both the source and destination of a blit.
+    *   @since Indev
+    */
+    bool supports_mip_generation(const context& context,
+                                 VkFormat       format);
+
+    /*! @brief Creates a vulkan compute pipeline using the provided configuration.
+    *   @related pipeline
+    *   @param[in] context The associated vulkan context wrapper.
+    *   @param[in,out] pipeline The pipeline wrapper to create.
+    *   @param[in] spec The configuration for this compute pipeline.
+    *   @since Indev
+    */
+    void create_compute_pipeline(const context&              context,
+                                 pipeline&                   pipeline,
+                                 const compute_pipeline_cfg& spec);
+
     /*! @brief Creates a vulkan raytracing pipeline.
     *   @related pipeline
     *   @param[in] context The associated vulkan context wrapper.
@@ -3,4 +3,9 @@
 #define POLYMORPH_VULKAN_USE_VALIDATION
 
 constexpr const char* VULKAN_ENGINE_NAME = "Polymorph Engine";
-constexpr uint32_t VULKAN_ENGINE_VERSION = VK_MAKE_VERSION(1, 0, 0);
\ No newline at end of file
+constexpr uint32_t VULKAN_ENGINE_VERSION = VK_MAKE_VERSION(1, 0, 0);
+
+constexpr VkDeviceSize VULKAN_STAGING_RING_SIZE = 64ull * 1024 * 1024;
+constexpr uint32_t VULKAN_UPLOAD_BATCH_COUNT = 4;
+constexpr VkDeviceSize VULKAN_FRAME_ALLOCATOR_SIZE = 8ull * 1024 * 1024;
+constexpr const char* VULKAN_PIPELINE_CACHE_PATH = "pipeline_cache.bin";
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace poly
+{
+    /// @brief A job run by a worker pool, given its index and the index of the thread running it.
+    using worker_job = void (*)(void* data, uint32_t job, uint32_t thread);
+
+    /// @brief A fixed set of threads which split the jobs of a dispatch between themselves and the dispatching thread.
+    struct worker_pool // worker.cpp
+    {
+        std::vector<std::thread> threads;
+        uint32_t                 thread_count; // Including the dispatching thread, which is always thread 0.
+
+        std::mutex               mutex;
+        std::condition_variable  wake;
+        std::condition_variable  done;
+
+        worker_job               job;
+        void*                    job_data;
+        uint32_t                 job_count;
+        std::atomic<uint32_t>    next;
+        std::atomic<uint32_t>    remaining;
+        uint32_t                 active;     // Workers draining the current dispatch.
+        uint64_t                 generation; // Bumped by every dispatch.
+        bool                     stop;
+    };
+
+    /*! @brief Starts a worker pool.
+    *   @memberof worker_pool
+    *   @param[in,out] pool The worker pool to start.
+    *   @param[in] thread_count The number of threads jobs run on, including the dispatching thread.
+    *   @since Indev
+    */
+    void create_worker_pool(worker_pool& pool,
+                            uint32_t     thread_count);
+
+    /*! @brief Stops and joins every worker thread.
+    *   @memberof worker_pool
+    *   @param[in,out] pool The worker pool to stop.
+    *   @since Indev
+    */
+    void destroy_worker_pool(worker_pool& pool);
+
+    /*! @brief Runs job_count jobs across the pool and the calling thread, returning once all of them have finished.
+    *   @memberof worker_pool
+    *   @note Must only be called from one thread at a time.
+    *   @param[in,out] pool The worker pool to run on.
+    *   @param[in] job_count The number of jobs.
+    *   @param[in] job The job to run, once per index.
+    *   @param[in] data The user data passed to every job.
+    *   @since Indev
+    */
+    void dispatch_jobs(worker_pool& pool,
+                       uint32_t     job_count,
+                       worker_job   job,
+                       void*        data);
+
+    /*! @brief Runs a callable once per job index across the pool, without allocating.
+    *   @memberof worker_pool
+    *   @param[in,out] pool The worker pool to run on.
+    *   @param[in] job_count The number of jobs.
+    *   @param[in] func A callable taking the job index and the thread index.
+    *   @since Indev
+    */
+    template <typename F>
+    void dispatch_jobs(worker_pool& pool, uint32_t job_count, F& func)
+    {
+        dispatch_jobs(pool, job_count, [](void* data, uint32_t job, uint32_t thread) { (*static_cast<F*>(data))(job, thread); }, &func);
+    }
+}
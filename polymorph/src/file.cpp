@@ -3,6 +3,17 @@
 
 #include <fstream>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define ASSERT(expr) { if(!(expr)) { print_error("File IO", #expr, __FILE__, __LINE__); } }
 
 using namespace poly;
@@ -53,4 +64,65 @@ std::string poly::read_file_str(const std::string& path)
     delete[] buffer;
 
     return str;
-}
\ No newline at end of file
+}
+
+void poly::map_file(mapped_file& file, const std::string& path)
+{
+    file = {};
+    file.descriptor = -1;
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        print_warn("File IO", "file '" + path + "' not found ");
+        throw std::runtime_error("file '" + path + "' not found ");
+    }
+
+    LARGE_INTEGER size{};
+    ASSERT(GetFileSizeEx(handle, &size));
+    file.file_handle = handle;
+    file.size = static_cast<size_t>(size.QuadPart);
+
+    if (file.size > 0)
+    {
+        file.mapping_handle = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        ASSERT(file.mapping_handle != NULL);
+        file.data = static_cast<const uint8_t*>(MapViewOfFile(file.mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        ASSERT(file.data != nullptr);
+    }
+#else
+    file.descriptor = open(path.c_str(), O_RDONLY);
+    if (file.descriptor < 0)
+    {
+        print_warn("File IO", "file '" + path + "' not found ");
+        throw std::runtime_error("file '" + path + "' not found ");
+    }
+
+    struct stat info{};
+    ASSERT(fstat(file.descriptor, &info) == 0);
+    file.size = static_cast<size_t>(info.st_size);
+
+    if (file.size > 0)
+    {
+        void* data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.descriptor, 0);
+        ASSERT(data != MAP_FAILED);
+        madvise(data, file.size, MADV_RANDOM); // Levels are read on demand, so read-ahead would only waste memory.
+        file.data = static_cast<const uint8_t*>(data);
+    }
+#endif
+}
+
+void poly::unmap_file(mapped_file& file)
+{
+#ifdef _WIN32
+    if (file.data != nullptr) UnmapViewOfFile(file.data);
+    if (file.mapping_handle != nullptr) CloseHandle(file.mapping_handle);
+    if (file.file_handle != nullptr) CloseHandle(file.file_handle);
+#else
+    if (file.data != nullptr) munmap(const_cast<uint8_t*>(file.data), file.size);
+    if (file.descriptor >= 0) close(file.descriptor);
+#endif
+    file = {};
+    file.descriptor = -1;
+}
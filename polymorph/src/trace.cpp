@@ -0,0 +1,159 @@
+#include "polymorph/trace.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace poly;
+
+// The zones of one thread. Only the owning thread writes, and publishes each zone by bumping the count.
+struct trace_thread
+{
+    struct zone
+    {
+        const char* name;
+        int64_t     start_ns;
+        int64_t     end_ns;
+    };
+
+    std::unique_ptr<zone[]>  zones;
+    std::atomic<uint32_t>    count;
+    std::atomic<uint64_t>    dropped;
+    std::atomic<uint32_t>    capture; // The capture the zones belong to, published after the count is reset for it.
+    uint32_t                 id;
+    std::atomic<const char*> name;
+};
+
+static std::mutex threads_mutex;
+static std::vector<std::unique_ptr<trace_thread>> threads; // Kept after their thread exits, so its zones can still be written.
+static std::atomic<uint32_t> capture_id{ 0 };
+
+// ------------------------- UTILS -------------------------
+
+static trace_thread& current_thread()
+{
+    thread_local trace_thread* thread = nullptr;
+    if (thread == nullptr)
+    {
+        auto created = std::make_unique<trace_thread>();
+        created->zones = std::make_unique<trace_thread::zone[]>(TRACE_THREAD_CAPACITY);
+        created->count = 0;
+        created->dropped = 0;
+        created->capture = capture_id.load(std::memory_order_relaxed);
+        created->name = nullptr;
+
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        created->id = static_cast<uint32_t>(threads.size());
+        thread = created.get();
+        threads.push_back(std::move(created));
+    }
+    return *thread;
+}
+
+// ------------------------- TRACE -------------------------
+
+void poly::write_json_string(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+void poly::record_trace_zone(const char* name, int64_t start_ns, int64_t end_ns)
+{
+    trace_thread& thread = current_thread();
+
+    // The first zone of a new capture discards the previous one, so starting a capture never touches other threads' buffers.
+    const uint32_t capture = capture_id.load(std::memory_order_relaxed);
+    if (thread.capture.load(std::memory_order_relaxed) != capture)
+    {
+        thread.dropped.store(0, std::memory_order_relaxed);
+        thread.count.store(0, std::memory_order_relaxed);
+        thread.capture.store(capture, std::memory_order_release);
+    }
+
+    const uint32_t count = thread.count.load(std::memory_order_relaxed);
+    if (count == TRACE_THREAD_CAPACITY)
+    {
+        thread.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    thread.zones[count] = { name, start_ns, end_ns };
+    thread.count.store(count + 1, std::memory_order_release);
+}
+
+void poly::start_trace_capture()
+{
+    capture_id.fetch_add(1, std::memory_order_relaxed);
+    trace_capturing.store(true, std::memory_order_relaxed);
+}
+
+void poly::stop_trace_capture()
+{
+    trace_capturing.store(false, std::memory_order_relaxed);
+}
+
+void poly::name_trace_thread(const char* name)
+{
+    current_thread().name.store(name, std::memory_order_release);
+}
+
+void poly::write_trace_events(FILE* file)
+{
+    const uint32_t capture = capture_id.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    fprintf(file, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}}");
+    for (const auto& thread : threads)
+    {
+        const char* name = thread->name.load(std::memory_order_acquire);
+        if (name != nullptr)
+        {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", thread->id);
+            write_json_string(file, name);
+            fprintf(file, "}}");
+        }
+        if (thread->capture.load(std::memory_order_acquire) != capture)
+        {
+            continue; // Recorded nothing since the capture started.
+        }
+
+        const uint32_t count = thread->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const trace_thread::zone& zone = thread->zones[i];
+            fprintf(file, ",\n{\"name\":");
+            write_json_string(file, zone.name);
+            fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread->id, static_cast<double>(zone.start_ns) * 1e-3, static_cast<double>(zone.end_ns - zone.start_ns) * 1e-3);
+        }
+        const uint64_t dropped = thread->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0)
+        {
+            printf("Trace buffer of thread %u full, dropped %llu zones\n", thread->id, static_cast<unsigned long long>(dropped));
+        }
+    }
+}
+
+bool poly::write_trace(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"sort_index\":0}}");
+    write_trace_events(file);
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
@@ -0,0 +1,220 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+
+using namespace poly::vk;
+
+constexpr VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+                                      | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT
+                                      | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+constexpr uint32_t LEGACY_BARRIER_CHUNK = 16;
+
+// ------------------------- UTILS -------------------------
+
+// Stages added by synchronization2 live above the 32 bits vkCmdPipelineBarrier takes.
+static VkPipelineStageFlags legacy_stages(VkPipelineStageFlags2 stages, VkPipelineStageFlags none)
+{
+    if (stages == 0)
+    {
+        return none;
+    }
+    if ((stages >> 32) != 0)
+    {
+        return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    return static_cast<VkPipelineStageFlags>(stages);
+}
+
+static VkAccessFlags legacy_access(VkAccessFlags2 access)
+{
+    VkAccessFlags legacy = static_cast<VkAccessFlags>(access & 0xffffffffull);
+    if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+    {
+        legacy |= VK_ACCESS_SHADER_READ_BIT;
+    }
+    if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+    {
+        legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+    }
+    return legacy;
+}
+
+// Converts a chunk at a time onto the stack, so the fallback records without allocating.
+static void record_legacy_barriers(VkCommandBuffer cmd, const VkImageMemoryBarrier2* image_barriers, uint32_t image_barrier_count,
+                                   const VkBufferMemoryBarrier2* buffer_barriers, uint32_t buffer_barrier_count)
+{
+    VkImageMemoryBarrier images[LEGACY_BARRIER_CHUNK];
+    VkBufferMemoryBarrier buffers[LEGACY_BARRIER_CHUNK];
+
+    uint32_t image_offset = 0;
+    uint32_t buffer_offset = 0;
+    while (image_offset < image_barrier_count || buffer_offset < buffer_barrier_count)
+    {
+        const uint32_t image_count = std::min(image_barrier_count - image_offset, LEGACY_BARRIER_CHUNK);
+        const uint32_t buffer_count = std::min(buffer_barrier_count - buffer_offset, LEGACY_BARRIER_CHUNK);
+        VkPipelineStageFlags2 src_stages = 0;
+        VkPipelineStageFlags2 dst_stages = 0;
+
+        for (uint32_t i = 0; i < image_count; i++)
+        {
+            const VkImageMemoryBarrier2& barrier = image_barriers[image_offset + i];
+            images[i] = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+            images[i].srcAccessMask = legacy_access(barrier.srcAccessMask);
+            images[i].dstAccessMask = legacy_access(barrier.dstAccessMask);
+            images[i].oldLayout = barrier.oldLayout;
+            images[i].newLayout = barrier.newLayout;
+            images[i].srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+            images[i].dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+            images[i].image = barrier.image;
+            images[i].subresourceRange = barrier.subresourceRange;
+            src_stages |= barrier.srcStageMask;
+            dst_stages |= barrier.dstStageMask;
+        }
+        for (uint32_t i = 0; i < buffer_count; i++)
+        {
+            const VkBufferMemoryBarrier2& barrier = buffer_barriers[buffer_offset + i];
+            buffers[i] = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+            buffers[i].srcAccessMask = legacy_access(barrier.srcAccessMask);
+            buffers[i].dstAccessMask = legacy_access(barrier.dstAccessMask);
+            buffers[i].srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+            buffers[i].dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+            buffers[i].buffer = barrier.buffer;
+            buffers[i].offset = barrier.offset;
+            buffers[i].size = barrier.size;
+            src_stages |= barrier.srcStageMask;
+            dst_stages |= barrier.dstStageMask;
+        }
+
+        vkCmdPipelineBarrier(cmd, legacy_stages(src_stages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), legacy_stages(dst_stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT), 0,
+                             0, VK_NULL_HANDLE, buffer_count, buffers, image_count, images);
+        image_offset += image_count;
+        buffer_offset += buffer_count;
+    }
+}
+
+// ------------------------- RESOURCE STATE -------------------------
+
+bool poly::vk::advance_resource_state(resource_state& state, const resource_access& next, bool discard,
+                                      VkPipelineStageFlags2& src_stages, VkAccessFlags2& src_access, VkImageLayout& old_layout)
+{
+    const bool writes = (next.access & WRITE_ACCESS) != 0;
+    const bool transition = discard || state.layout != next.layout;
+    old_layout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+
+    bool barrier = false;
+    if (transition || writes)
+    {
+        // Layout transitions write the whole image, so both wait for every access since the last write.
+        src_stages = state.write_stages | state.read_stages;
+        src_access = state.write_access;
+        barrier = transition || src_stages != 0;
+
+        state.layout = next.layout;
+        state.write_stages = next.stages;
+        state.write_access = next.access & WRITE_ACCESS;
+        state.read_stages = writes ? 0 : next.stages;
+        state.read_access = writes ? 0 : next.access;
+    }
+    else
+    {
+        // The last write is only visible to the stages and access types of the reads which waited for it.
+        src_stages = state.write_stages;
+        src_access = state.write_access;
+        barrier = state.write_stages != 0 && ((state.read_stages & next.stages) != next.stages || (state.read_access & next.access) != next.access);
+
+        state.read_stages |= next.stages;
+        state.read_access |= next.access;
+    }
+    return barrier;
+}
+
+// ------------------------- BARRIER BATCH -------------------------
+
+void poly::vk::access_image(barrier_batch& batch, image& img, const resource_access& next, bool discard)
+{
+    VkPipelineStageFlags2 src_stages = 0;
+    VkAccessFlags2 src_access = 0;
+    VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (!advance_resource_state(img.state, next, discard, src_stages, src_access, old_layout))
+    {
+        return;
+    }
+    ASSERT_VK(std::none_of(batch.images.begin(), batch.images.end(), [&](const VkImageMemoryBarrier2& b) { return b.image == img.v_image; }));
+
+    VkImageMemoryBarrier2& barrier = batch.images.emplace_back();
+    barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    barrier.srcStageMask = src_stages;
+    barrier.srcAccessMask = src_access;
+    barrier.dstStageMask = next.stages;
+    barrier.dstAccessMask = next.access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = next.layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = img.v_image;
+    barrier.subresourceRange.aspectMask = get_format_aspect(img.format);
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+}
+
+void poly::vk::access_buffer(barrier_batch& batch, buffer& buf, const resource_access& next)
+{
+    resource_access buffer_access = next;
+    buffer_access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkPipelineStageFlags2 src_stages = 0;
+    VkAccessFlags2 src_access = 0;
+    VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (!advance_resource_state(buf.state, buffer_access, false, src_stages, src_access, old_layout))
+    {
+        return;
+    }
+    ASSERT_VK(std::none_of(batch.buffers.begin(), batch.buffers.end(), [&](const VkBufferMemoryBarrier2& b) { return b.buffer == buf.value; }));
+
+    VkBufferMemoryBarrier2& barrier = batch.buffers.emplace_back();
+    barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2 };
+    barrier.srcStageMask = src_stages;
+    barrier.srcAccessMask = src_access;
+    barrier.dstStageMask = next.stages;
+    barrier.dstAccessMask = next.access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buf.value;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+}
+
+void poly::vk::record_barriers(const context& context, const command_buffer& command_buffer, const VkImageMemoryBarrier2* image_barriers, uint32_t image_barrier_count,
+                               const VkBufferMemoryBarrier2* buffer_barriers, uint32_t buffer_barrier_count)
+{
+    if (image_barrier_count == 0 && buffer_barrier_count == 0)
+    {
+        return;
+    }
+
+    if (context.device.cmd_pipeline_barrier2 == nullptr)
+    {
+        record_legacy_barriers(command_buffer.buf, image_barriers, image_barrier_count, buffer_barriers, buffer_barrier_count);
+        return;
+    }
+
+    VkDependencyInfo dependency{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    dependency.imageMemoryBarrierCount = image_barrier_count;
+    dependency.pImageMemoryBarriers = image_barriers;
+    dependency.bufferMemoryBarrierCount = buffer_barrier_count;
+    dependency.pBufferMemoryBarriers = buffer_barriers;
+    context.device.cmd_pipeline_barrier2(command_buffer.buf, &dependency);
+}
+
+void poly::vk::flush_barriers(const context& context, const command_buffer& command_buffer, barrier_batch& batch)
+{
+    record_barriers(context, command_buffer, batch.images.data(), static_cast<uint32_t>(batch.images.size()),
+                    batch.buffers.data(), static_cast<uint32_t>(batch.buffers.size()));
+
+    // Capacity is kept, so a steady frame batches without allocating.
+    batch.images.clear();
+    batch.buffers.clear();
+}
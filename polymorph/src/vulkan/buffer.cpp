@@ -3,21 +3,42 @@
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
+#include <algorithm>
+
 using namespace poly::vk;
 
-void poly::vk::create_staged_buffer(const context& context, buffer& buf, VkDeviceSize size, VkBufferUsageFlags usage, const void*  input_data)
+// ------------------------- UTILS -------------------------
+
+static bool overlaps_regions(const std::vector<VkBufferCopy>& regions, VkDeviceSize dst_offset, VkDeviceSize size)
 {
- 	buffer staging {};
-	create_buffer(context, staging, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	store_buffer(context, staging, input_data);
+	for (const auto& region : regions)
+	{
+		if (dst_offset < region.dstOffset + region.size && region.dstOffset < dst_offset + size)
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
-	create_buffer(context, buf, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	copy_buffer(context, staging.value, buf.value, size);
+// Orders the copies recorded before it ahead of the ones after it, where they write the same bytes.
+static void record_write_barrier(VkCommandBuffer cmd)
+{
+	VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+}
 
-	destroy_buffer(context, staging);
+// ------------------------- BUFFER -------------------------
+
+upload_ticket poly::vk::create_staged_buffer(context& context, buffer& buf, VkDeviceSize size, VkBufferUsageFlags usage, const void*  input_data)
+{
+	create_buffer(context, buf, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	return enqueue_buffer_upload(context, context.uploads, buf, 0, size, input_data);
 }
 
-void poly::vk::create_buffer(const context& context, buffer& buf, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_props)
+static void allocate_buffer(const context& context, buffer& buf, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_props, VmaAllocationCreateFlags flags)
 {
 	VkBufferCreateInfo buf_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
 	buf_info.size = size;
@@ -26,57 +47,242 @@ void poly::vk::create_buffer(const context& context, buffer& buf, VkDeviceSize s
 
 	VmaAllocationCreateInfo vma_allocation_info{};
 	vma_allocation_info.requiredFlags = memory_props;
-	vma_allocation_info.flags = memory_props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : 0;
+	vma_allocation_info.flags = flags;
 	vma_allocation_info.usage = VMA_MEMORY_USAGE_AUTO;
-	vmaCreateBuffer(context.allocator, &buf_info, &vma_allocation_info, &buf.value, &buf.allocation, VK_NULL_HANDLE);
+
+	VmaAllocationInfo allocation_info{};
+	CHECK_VK(vmaCreateBuffer(context.allocator, &buf_info, &vma_allocation_info, &buf.value, &buf.allocation, &allocation_info));
+
+	buf.size = size;
+	buf.usage = usage;
+	buf.category = memory_category::general;
+	buf.mapped = allocation_info.pMappedData;
+	buf.state = {};
+
+	track_allocation(context, buf.category, allocation_info.size);
+}
+
+void poly::vk::create_buffer(const context& context, buffer& buf, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_props)
+{
+	allocate_buffer(context, buf, size, usage, memory_props, memory_props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : 0);
+}
+
+void poly::vk::create_mapped_buffer(const context& context, buffer& buf, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_props)
+{
+	ASSERT_VK(memory_props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	// Write-only buffers can live in write-combined memory, readback needs cached memory for random access.
+	VmaAllocationCreateFlags access = memory_props & VK_MEMORY_PROPERTY_HOST_CACHED_BIT ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+	allocate_buffer(context, buf, size, usage, memory_props, access | VMA_ALLOCATION_CREATE_MAPPED_BIT);
 }
 
 void poly::vk::store_buffer(const context& context, const buffer& buf, const void* input_data)
 {
-	void* data = 0;
-	vmaMapMemory(context.allocator, buf.allocation, &data);
-	memcpy(data, input_data, static_cast<size_t>(buf.allocation->GetSize()));
-	vmaUnmapMemory(context.allocator, buf.allocation);
+	write_buffer(context, buf, input_data, 0, buf.size);
 }
 
-void poly::vk::copy_buffer(const context& context, VkBuffer src, VkBuffer dst, VkDeviceSize size)
+void poly::vk::write_buffer(const context& context, const buffer& buf, const void* data, VkDeviceSize offset, VkDeviceSize size)
+{
+	ASSERT_VK(offset <= buf.size && size <= buf.size - offset);
+
+	void* mapped = buf.mapped;
+	if (mapped == nullptr)
+	{
+		CHECK_VK(vmaMapMemory(context.allocator, buf.allocation, &mapped));
+	}
+
+	memcpy(static_cast<uint8_t*>(mapped) + offset, data, static_cast<size_t>(size));
+	CHECK_VK(vmaFlushAllocation(context.allocator, buf.allocation, offset, size)); // No-op for coherent memory.
+
+	if (buf.mapped == nullptr)
+	{
+		vmaUnmapMemory(context.allocator, buf.allocation);
+	}
+}
+
+void poly::vk::read_buffer(const context& context, const buffer& buf, void* data, VkDeviceSize offset, VkDeviceSize size)
+{
+	ASSERT_VK(offset <= buf.size && size <= buf.size - offset);
+
+	void* mapped = buf.mapped;
+	if (mapped == nullptr)
+	{
+		CHECK_VK(vmaMapMemory(context.allocator, buf.allocation, &mapped));
+	}
+
+	CHECK_VK(vmaInvalidateAllocation(context.allocator, buf.allocation, offset, size)); // No-op for coherent memory.
+	memcpy(data, static_cast<const uint8_t*>(mapped) + offset, static_cast<size_t>(size));
+
+	if (buf.mapped == nullptr)
+	{
+		vmaUnmapMemory(context.allocator, buf.allocation);
+	}
+}
+
+void poly::vk::add_buffer_copy(copy_batch& batch, VkBuffer src, VkBuffer dst, VkDeviceSize src_offset, VkDeviceSize dst_offset, VkDeviceSize size)
+{
+	batch.buffer_copies.push_back(buffer_copy{ src, dst, src_offset, dst_offset, size });
+}
+
+void poly::vk::add_buffer_image_copy(copy_batch& batch, VkBuffer src, VkImage dst, VkImageLayout dst_layout, const VkBufferImageCopy& region)
+{
+	batch.image_copies.push_back(buffer_image_copy{ src, dst, dst_layout, region });
+}
+
+void poly::vk::record_copy_batch(const command_buffer& cmd_buf, copy_batch& batch)
+{
+	// Grouped by destination only, keeping the order copies were added in, so later copies still win where they overlap earlier ones.
+	std::stable_sort(batch.buffer_copies.begin(), batch.buffer_copies.end(), [](const buffer_copy& a, const buffer_copy& b) { return a.dst < b.dst; });
+
+	auto& regions = batch.scratch_buffer_regions; // Every region written to the current destination since its last barrier.
+	size_t command_start = 0;                     // The first region of the command being built.
+	const buffer_copy* command = nullptr;          // The source and destination of that command.
+	VkDeviceSize written_begin = 0;
+	VkDeviceSize written_end = 0;
+
+	auto record_command = [&]()
+	{
+		if (command != nullptr && regions.size() > command_start)
+		{
+			vkCmdCopyBuffer(cmd_buf.buf, command->src, command->dst, static_cast<uint32_t>(regions.size() - command_start), regions.data() + command_start);
+		}
+		command_start = regions.size();
+	};
+
+	for (const auto& copy : batch.buffer_copies)
+	{
+		if (command == nullptr || copy.dst != command->dst)
+		{
+			record_command();
+			regions.clear();
+			command_start = 0;
+			written_begin = copy.dst_offset;
+			written_end = copy.dst_offset;
+		}
+		else if (copy.dst_offset < written_end && written_begin < copy.dst_offset + copy.size && overlaps_regions(regions, copy.dst_offset, copy.size))
+		{
+			// Regions of one command, or of commands without a barrier between them, may be written in any order.
+			record_command();
+			record_write_barrier(cmd_buf.buf);
+			regions.clear();
+			command_start = 0;
+			written_begin = copy.dst_offset;
+			written_end = copy.dst_offset;
+		}
+		else if (copy.src != command->src)
+		{
+			record_command();
+		}
+		command = &copy;
+		written_begin = std::min(written_begin, copy.dst_offset);
+		written_end = std::max(written_end, copy.dst_offset + copy.size);
+
+		if (regions.size() > command_start && regions.back().srcOffset + regions.back().size == copy.src_offset && regions.back().dstOffset + regions.back().size == copy.dst_offset)
+		{
+			regions.back().size += copy.size; // Contiguous in both buffers, so one region covers both.
+			continue;
+		}
+		regions.push_back(VkBufferCopy{ copy.src_offset, copy.dst_offset, copy.size });
+	}
+	record_command();
+
+	std::stable_sort(batch.image_copies.begin(), batch.image_copies.end(), [](const buffer_image_copy& a, const buffer_image_copy& b)
+		{
+			if (a.dst != b.dst) return a.dst < b.dst;
+			if (a.src != b.src) return a.src < b.src;
+			return a.dst_layout < b.dst_layout;
+		});
+
+	auto& image_regions = batch.scratch_image_regions;
+	for (size_t i = 0; i < batch.image_copies.size(); )
+	{
+		const buffer_image_copy& first = batch.image_copies[i];
+		image_regions.clear();
+
+		for (; i < batch.image_copies.size() && batch.image_copies[i].src == first.src && batch.image_copies[i].dst == first.dst && batch.image_copies[i].dst_layout == first.dst_layout; i++)
+		{
+			image_regions.push_back(batch.image_copies[i].region);
+		}
+
+		vkCmdCopyBufferToImage(cmd_buf.buf, first.src, first.dst, first.dst_layout, static_cast<uint32_t>(image_regions.size()), image_regions.data());
+	}
+
+	batch.buffer_copies.clear();
+	batch.image_copies.clear();
+}
+
+void poly::vk::submit_copy_batch(const context& context, copy_batch& batch)
 {
+	if (batch.buffer_copies.empty() && batch.image_copies.empty())
+	{
+		return;
+	}
+
 	VkCommandBufferAllocateInfo alloc_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
 	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 	alloc_info.commandPool = context.device.v_command_pool;
 	alloc_info.commandBufferCount = 1;
-	alloc_info.pNext = NULL;
 
-	VkCommandBuffer buf;
-	vkAllocateCommandBuffers(context.device.v_logical, &alloc_info, &buf);
+	command_buffer cmd_buf;
+	CHECK_VK(vkAllocateCommandBuffers(context.device.v_logical, &alloc_info, &cmd_buf.buf));
 
-	VkCommandBufferBeginInfo begin_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO }; // recording
+	VkCommandBufferBeginInfo begin_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
 	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(buf, &begin_info);
+	CHECK_VK(vkBeginCommandBuffer(cmd_buf.buf, &begin_info));
 
-	VkBufferCopy copy_region{};
-	copy_region.srcOffset = 0; // Optional
-	copy_region.dstOffset = 0; // Optional
-	copy_region.size = size;
-	vkCmdCopyBuffer(buf, src, dst, 1, &copy_region);
+	// Earlier frames may still be using the regions being overwritten.
+	VkMemoryBarrier before{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	before.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	before.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd_buf.buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
 
-	vkEndCommandBuffer(buf);
+	record_copy_batch(cmd_buf, batch);
 
-	// execute transfer
+	VkMemoryBarrier after{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	after.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd_buf.buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &after, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+	CHECK_VK(vkEndCommandBuffer(cmd_buf.buf));
+
+	VkFenceCreateInfo fence_info{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+	VkFence fence;
+	CHECK_VK(vkCreateFence(context.device.v_logical, &fence_info, VK_NULL_HANDLE, &fence));
 
 	VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &buf;
+	submit_info.pCommandBuffers = &cmd_buf.buf;
 
-	vkQueueSubmit(context.device.v_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-	vkQueueWaitIdle(context.device.v_graphics_queue);
+	// Waits on this submit alone, rather than idling the whole queue.
+	CHECK_VK(vkQueueSubmit(context.device.v_graphics_queue, 1, &submit_info, fence));
+	CHECK_VK(vkWaitForFences(context.device.v_logical, 1, &fence, VK_TRUE, UINT64_MAX));
 
-	vkFreeCommandBuffers(context.device.v_logical, context.device.v_command_pool, 1, &buf);
+	vkDestroyFence(context.device.v_logical, fence, VK_NULL_HANDLE);
+	vkFreeCommandBuffers(context.device.v_logical, context.device.v_command_pool, 1, &cmd_buf.buf);
+}
+
+void poly::vk::copy_buffer(const context& context, VkBuffer src, VkBuffer dst, VkDeviceSize size)
+{
+	copy_batch batch;
+	add_buffer_copy(batch, src, dst, 0, 0, size);
+	submit_copy_batch(context, batch);
 }
 
 void poly::vk::destroy_buffer(const context& context, buffer& buf)
 {
+	if (buf.allocation != VK_NULL_HANDLE)
+	{
+		VmaAllocationInfo allocation_info{};
+		vmaGetAllocationInfo(context.allocator, buf.allocation, &allocation_info);
+		track_free(context, buf.category, allocation_info.size);
+	}
+
 	vmaDestroyBuffer(context.allocator, buf.value, buf.allocation);
 	buf.allocation = VK_NULL_HANDLE;
 	buf.value = VK_NULL_HANDLE;
+	buf.size = 0;
+	buf.usage = 0;
+	buf.category = memory_category::general;
+	buf.mapped = nullptr;
+	buf.state = {};
 }
\ No newline at end of file
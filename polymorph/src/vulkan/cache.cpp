@@ -0,0 +1,235 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+static void hash_combine(size_t& seed, uint64_t value)
+{
+    seed ^= static_cast<size_t>(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+static uint64_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Floats are compared by their bits, so that the hash and equality always agree.
+static bool same_float(float a, float b)
+{
+    return float_bits(a) == float_bits(b);
+}
+
+// ------------------------- HASHING -------------------------
+
+size_t create_info_hash::operator()(const VkSamplerCreateInfo& info) const
+{
+    size_t seed = 0;
+    hash_combine(seed, info.flags);
+    hash_combine(seed, info.magFilter);
+    hash_combine(seed, info.minFilter);
+    hash_combine(seed, info.mipmapMode);
+    hash_combine(seed, info.addressModeU);
+    hash_combine(seed, info.addressModeV);
+    hash_combine(seed, info.addressModeW);
+    hash_combine(seed, float_bits(info.mipLodBias));
+    hash_combine(seed, info.anisotropyEnable);
+    hash_combine(seed, float_bits(info.maxAnisotropy));
+    hash_combine(seed, info.compareEnable);
+    hash_combine(seed, info.compareOp);
+    hash_combine(seed, float_bits(info.minLod));
+    hash_combine(seed, float_bits(info.maxLod));
+    hash_combine(seed, info.borderColor);
+    hash_combine(seed, info.unnormalizedCoordinates);
+    return seed;
+}
+
+size_t create_info_hash::operator()(const VkImageViewCreateInfo& info) const
+{
+    size_t seed = 0;
+    hash_combine(seed, info.flags);
+    hash_combine(seed, reinterpret_cast<uint64_t>(info.image));
+    hash_combine(seed, info.viewType);
+    hash_combine(seed, info.format);
+    hash_combine(seed, info.components.r);
+    hash_combine(seed, info.components.g);
+    hash_combine(seed, info.components.b);
+    hash_combine(seed, info.components.a);
+    hash_combine(seed, info.subresourceRange.aspectMask);
+    hash_combine(seed, info.subresourceRange.baseMipLevel);
+    hash_combine(seed, info.subresourceRange.levelCount);
+    hash_combine(seed, info.subresourceRange.baseArrayLayer);
+    hash_combine(seed, info.subresourceRange.layerCount);
+    return seed;
+}
+
+bool create_info_equal::operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const
+{
+    return a.flags == b.flags
+        && a.magFilter == b.magFilter
+        && a.minFilter == b.minFilter
+        && a.mipmapMode == b.mipmapMode
+        && a.addressModeU == b.addressModeU
+        && a.addressModeV == b.addressModeV
+        && a.addressModeW == b.addressModeW
+        && same_float(a.mipLodBias, b.mipLodBias)
+        && a.anisotropyEnable == b.anisotropyEnable
+        && same_float(a.maxAnisotropy, b.maxAnisotropy)
+        && a.compareEnable == b.compareEnable
+        && a.compareOp == b.compareOp
+        && same_float(a.minLod, b.minLod)
+        && same_float(a.maxLod, b.maxLod)
+        && a.borderColor == b.borderColor
+        && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+bool create_info_equal::operator()(const VkImageViewCreateInfo& a, const VkImageViewCreateInfo& b) const
+{
+    return a.flags == b.flags
+        && a.image == b.image
+        && a.viewType == b.viewType
+        && a.format == b.format
+        && a.components.r == b.components.r
+        && a.components.g == b.components.g
+        && a.components.b == b.components.b
+        && a.components.a == b.components.a
+        && a.subresourceRange.aspectMask == b.subresourceRange.aspectMask
+        && a.subresourceRange.baseMipLevel == b.subresourceRange.baseMipLevel
+        && a.subresourceRange.levelCount == b.subresourceRange.levelCount
+        && a.subresourceRange.baseArrayLayer == b.subresourceRange.baseArrayLayer
+        && a.subresourceRange.layerCount == b.subresourceRange.layerCount;
+}
+
+// ------------------------- SAMPLERS -------------------------
+
+VkSampler poly::vk::acquire_sampler(const context& context, const VkSamplerCreateInfo& requested)
+{
+    ASSERT_VK(requested.pNext == nullptr);
+
+    // Normalised before lookup, so requests which would create the same sampler share it.
+    VkSamplerCreateInfo info = requested;
+    if (context.device.max_sampler_anisotropy == 0.0f)
+    {
+        info.anisotropyEnable = VK_FALSE;
+    }
+    info.maxAnisotropy = info.anisotropyEnable ? std::min(info.maxAnisotropy, context.device.max_sampler_anisotropy) : 1.0f;
+
+    std::lock_guard<std::mutex> lock(context.samplers.mutex);
+
+    auto it = context.samplers.entries.find(info);
+    if (it != context.samplers.entries.end())
+    {
+        it->second.refs++;
+        return it->second.handle;
+    }
+
+    VkSampler sampler;
+    CHECK_VK(vkCreateSampler(context.device.v_logical, &info, VK_NULL_HANDLE, &sampler));
+    context.samplers.entries.emplace(info, cached_sampler{ sampler, 1 });
+    context.samplers.keys.emplace(sampler, info);
+    return sampler;
+}
+
+void poly::vk::release_sampler(const context& context, VkSampler sampler)
+{
+    std::lock_guard<std::mutex> lock(context.samplers.mutex);
+
+    auto key = context.samplers.keys.find(sampler);
+    ASSERT_VK(key != context.samplers.keys.end());
+
+    auto it = context.samplers.entries.find(key->second);
+    if (--it->second.refs == 0)
+    {
+        vkDestroySampler(context.device.v_logical, sampler, VK_NULL_HANDLE);
+        context.samplers.entries.erase(it);
+        context.samplers.keys.erase(key);
+    }
+}
+
+VkSamplerCreateInfo poly::vk::make_sampler_info(VkFilter filter, VkSamplerAddressMode address_mode, float max_anisotropy)
+{
+    VkSamplerCreateInfo info{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    info.magFilter = filter;
+    info.minFilter = filter;
+    info.mipmapMode = filter == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    info.addressModeU = address_mode;
+    info.addressModeV = address_mode;
+    info.addressModeW = address_mode;
+    info.mipLodBias = 0.0f;
+    info.anisotropyEnable = max_anisotropy > 0.0f ? VK_TRUE : VK_FALSE;
+    info.maxAnisotropy = max_anisotropy;
+    info.compareEnable = VK_FALSE;
+    info.compareOp = VK_COMPARE_OP_ALWAYS;
+    info.minLod = 0.0f;
+    info.maxLod = VK_LOD_CLAMP_NONE;
+    info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    info.unnormalizedCoordinates = VK_FALSE;
+    return info;
+}
+
+// ------------------------- IMAGE VIEWS -------------------------
+
+VkImageView poly::vk::acquire_image_view(const context& context, const VkImageViewCreateInfo& info)
+{
+    ASSERT_VK(info.pNext == nullptr);
+
+    std::lock_guard<std::mutex> lock(context.image_views.mutex);
+
+    auto it = context.image_views.entries.find(info);
+    if (it != context.image_views.entries.end())
+    {
+        it->second.refs++;
+        return it->second.handle;
+    }
+
+    VkImageView view;
+    CHECK_VK(vkCreateImageView(context.device.v_logical, &info, VK_NULL_HANDLE, &view));
+    context.image_views.entries.emplace(info, cached_image_view{ view, 1 });
+    context.image_views.keys.emplace(view, info);
+    return view;
+}
+
+void poly::vk::release_image_view(const context& context, VkImageView view)
+{
+    std::lock_guard<std::mutex> lock(context.image_views.mutex);
+
+    auto key = context.image_views.keys.find(view);
+    ASSERT_VK(key != context.image_views.keys.end());
+
+    auto it = context.image_views.entries.find(key->second);
+    if (--it->second.refs == 0)
+    {
+        vkDestroyImageView(context.device.v_logical, view, VK_NULL_HANDLE);
+        context.image_views.entries.erase(it);
+        context.image_views.keys.erase(key);
+    }
+}
+
+// ------------------------- CLEANUP -------------------------
+
+void poly::vk::destroy_handle_caches(const context& context)
+{
+    if (!context.samplers.entries.empty() || !context.image_views.entries.empty())
+    {
+        print_warn("Vulkan", std::to_string(context.samplers.entries.size()) + " samplers and " + std::to_string(context.image_views.entries.size()) + " image views were never released");
+    }
+
+    for (auto& [info, entry] : context.samplers.entries)
+    {
+        vkDestroySampler(context.device.v_logical, entry.handle, VK_NULL_HANDLE);
+    }
+    context.samplers.entries.clear();
+    context.samplers.keys.clear();
+
+    for (auto& [info, entry] : context.image_views.entries)
+    {
+        vkDestroyImageView(context.device.v_logical, entry.handle, VK_NULL_HANDLE);
+    }
+    context.image_views.entries.clear();
+    context.image_views.keys.clear();
+}
@@ -1,5 +1,7 @@
 #include "polymorph/vulkan/context.h"
 
+#include <algorithm>
+
 using namespace poly::vk;
 
 void poly::vk::create_command_pool(context& context)
@@ -44,7 +46,7 @@ void poly::vk::end_recording_commands(const command_buffer& cmd_buf)
 	CHECK_VK(vkEndCommandBuffer(cmd_buf.buf));
 }
 
-void poly::vk::begin_render_pass(const command_buffer& cmd_buf, VkRenderPass pass, const framebuffer& framebuffer, const VkExtent2D& extent)
+void poly::vk::begin_render_pass(const command_buffer& cmd_buf, VkRenderPass pass, const framebuffer& framebuffer, const VkExtent2D& extent, VkSubpassContents contents)
 {
 	VkRenderPassBeginInfo info{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
 	info.renderPass = pass;
@@ -58,7 +60,7 @@ void poly::vk::begin_render_pass(const command_buffer& cmd_buf, VkRenderPass pas
 	info.clearValueCount = 1;
 	info.pClearValues = &clear;
 
-	vkCmdBeginRenderPass(cmd_buf.buf, &info, VK_SUBPASS_CONTENTS_INLINE); // TODO: make configurable VK_SUBPASS_CONTENTS_???
+	vkCmdBeginRenderPass(cmd_buf.buf, &info, contents);
 }
 
 void poly::vk::end_render_pass(const command_buffer& cmd_buf)
@@ -68,13 +70,30 @@ void poly::vk::end_render_pass(const command_buffer& cmd_buf)
 
 void poly::vk::begin_frame(context& context, draw_state_context& dsc)
 {
-	vkWaitForFences(context.device.v_logical, 1, &dsc.sync.fences_in_flight[dsc.current_frame], VK_TRUE, UINT64_MAX);
+	POLY_TRACE_ZONE("begin_frame");
+	{
+		POLY_TRACE_ZONE("wait for frame slot");
+		// The frame this slot last submitted, which is usually long finished, so the wait rarely blocks.
+		wait_timeline(context, dsc.sync.graphics, dsc.sync.frame_numbers[dsc.current_frame]);
+	}
+	{
+		POLY_TRACE_ZONE("retire frame slot");
+		update_frame_latency(context, dsc.sync);
+		reset_frame_allocator(context.transient, dsc.current_frame); // The GPU is done with this frame's transient data.
+		flush_deletion_queue(context, context.deletions, dsc.current_frame);
+		update_memory_budget(context, context.budget);
+	}
 
-	VkResult result = vkAcquireNextImageKHR(context.device.v_logical, context.swapchain.v_swapchain, UINT64_MAX, dsc.sync.semas_image_available[dsc.current_frame], VK_NULL_HANDLE, &dsc.current_image_index);
+	VkResult result;
+	{
+		POLY_TRACE_ZONE("acquire image");
+		result = vkAcquireNextImageKHR(context.device.v_logical, context.swapchain.v_swapchain, UINT64_MAX, dsc.sync.semas_image_available[dsc.current_frame], VK_NULL_HANDLE, &dsc.current_image_index);
+	}
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		recreate_swapchain(context);
+		skip_frame_presents(dsc.sync.latency, dsc.sync.frame_number);
 		return;
 	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
@@ -83,40 +102,67 @@ void poly::vk::begin_frame(context& context, draw_state_context& dsc)
 		throw std::runtime_error("Swapchain out of date, unable to acquire a new image");
 	}
 
-	vkResetFences(context.device.v_logical, 1, &dsc.sync.fences_in_flight[dsc.current_frame]);
-
 	vkResetCommandBuffer(dsc.command_buffers.values[dsc.current_frame].buf, 0);
 }
 
 void poly::vk::end_frame(context& context, draw_state_context& dsc)
 {
+	POLY_TRACE_ZONE("end_frame");
+	{
+		POLY_TRACE_ZONE("flush uploads");
+		flush_uploads(context, context.uploads);
+		submit_upload_handoffs(context, context.uploads); // Acquired ahead of the frame, so finished uploads are ready to be read by it.
+		flush_frame_allocator(context, context.transient);
+	}
+
 	VkSubmitInfo submit_info{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	std::vector<VkCommandBuffer> raw_bufs;
-	for (auto& cb : dsc.command_buffers.values)
+	// Binary semaphores ignore their entries in the timeline values.
+	VkSemaphore wait_semaphores[2] = { dsc.sync.semas_image_available[dsc.current_frame] };
+	VkPipelineStageFlags wait_stages[2] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	uint64_t wait_values[2] = { 0 };
+	submit_info.waitSemaphoreCount = 1;
+	if (dsc.compute != nullptr && dsc.compute->pending)
 	{
-		raw_bufs.push_back(cb.buf);
+		// Only the stages reading compute results wait, so the rest of the frame overlaps the compute queue.
+		wait_semaphores[1] = dsc.compute->timeline.v_semaphore;
+		wait_stages[1] = dsc.compute->wait_stages;
+		wait_values[1] = dsc.compute->timeline.submitted;
+		submit_info.waitSemaphoreCount = 2;
+		dsc.compute->pending = false;
 	}
-
-	VkSemaphore wait_semaphores[] = { dsc.sync.semas_image_available[dsc.current_frame] };
-	VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submit_info.waitSemaphoreCount = 1;
 	submit_info.pWaitSemaphores = wait_semaphores;
 	submit_info.pWaitDstStageMask = wait_stages;
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &raw_bufs[dsc.current_frame];
-	VkSemaphore signal_semaphores[] = { dsc.sync.semas_render_finished[dsc.current_frame] };
-	submit_info.signalSemaphoreCount = 1;
+	submit_info.pCommandBuffers = &dsc.command_buffers.values[dsc.current_frame].buf; // command_buffer only wraps the handle, so no copy is needed.
+
+	const uint64_t frame_number = next_timeline_value(dsc.sync.graphics, dsc.sync.frame_number);
+	VkSemaphore signal_semaphores[] = { context.swapchain.semas_render_finished[dsc.current_image_index], dsc.sync.graphics.v_semaphore };
+	uint64_t signal_values[] = { 0, frame_number };
+	submit_info.signalSemaphoreCount = 2;
 	submit_info.pSignalSemaphores = signal_semaphores;
 
-	CHECK_VK(vkQueueSubmit(context.device.v_graphics_queue, 1, &submit_info, dsc.sync.fences_in_flight[dsc.current_frame]));
+	VkTimelineSemaphoreSubmitInfo timeline_info{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+	timeline_info.waitSemaphoreValueCount = submit_info.waitSemaphoreCount;
+	timeline_info.pWaitSemaphoreValues = wait_values;
+	timeline_info.signalSemaphoreValueCount = submit_info.signalSemaphoreCount;
+	timeline_info.pSignalSemaphoreValues = signal_values;
+	submit_info.pNext = &timeline_info;
+
+	{
+		POLY_TRACE_ZONE("queue submit");
+		CHECK_VK(vkQueueSubmit(context.device.v_graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+	}
+	mark_frame_submitted(dsc.sync.latency, frame_number);
+	dsc.sync.frame_numbers[dsc.current_frame] = frame_number;
+	dsc.sync.frame_number++;
 
 	VkPresentInfoKHR present_info{};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
 	present_info.waitSemaphoreCount = 1;
-	present_info.pWaitSemaphores = signal_semaphores;
+	present_info.pWaitSemaphores = signal_semaphores; // Only the binary semaphore, which presentation requires.
 
 	VkSwapchainKHR swapChains[] = { context.swapchain.v_swapchain };
 	present_info.swapchainCount = 1;
@@ -124,10 +170,24 @@ void poly::vk::end_frame(context& context, draw_state_context& dsc)
 	present_info.pImageIndices = &dsc.current_image_index;
 	present_info.pResults = nullptr; // Optional
 
-	VkResult result = vkQueuePresentKHR(context.device.v_present_queue, &present_info);
+	// The frame number identifies the present, so its completion can be waited on for latency measurements.
+	VkPresentIdKHR present_id{ VK_STRUCTURE_TYPE_PRESENT_ID_KHR };
+	present_id.swapchainCount = 1;
+	present_id.pPresentIds = &frame_number;
+	if (context.device.supports_present_wait)
+	{
+		present_info.pNext = &present_id;
+	}
+
+	VkResult result;
+	{
+		POLY_TRACE_ZONE("queue present");
+		result = vkQueuePresentKHR(context.device.v_present_queue, &present_info);
+	}
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
 		recreate_swapchain(context);
+		skip_frame_presents(dsc.sync.latency, dsc.sync.frame_number);
 	}
 	else if (result != VK_SUCCESS)
 	{
@@ -135,5 +195,5 @@ void poly::vk::end_frame(context& context, draw_state_context& dsc)
 		throw std::runtime_error("Swapchain out of date, failed to present image");
 	}
 
-	dsc.current_frame = (dsc.current_frame + 1) % dsc.max_frames;
+	dsc.current_frame = (dsc.current_frame + 1) % std::min(dsc.max_frames, context.swapchain.frames_in_flight);
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "polymorph/vulkan/context.h"
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+static uint32_t group_count(uint32_t threads, uint32_t group_size)
+{
+    return (threads + group_size - 1) / group_size;
+}
+
+// ------------------------- ASYNC COMPUTE -------------------------
+
+void poly::vk::create_async_compute(const context& context, async_compute& compute, uint32_t frame_count)
+{
+    compute.frame = 0;
+    compute.dedicated = context.device.compute_queue_index != context.device.graphics_queue_index;
+    compute.pending = false;
+    compute.wait_stages = 0;
+
+    VkCommandPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = context.device.compute_queue_index;
+    CHECK_VK(vkCreateCommandPool(context.device.v_logical, &pool_info, VK_NULL_HANDLE, &compute.v_command_pool));
+
+    compute.v_cmds.resize(frame_count);
+    VkCommandBufferAllocateInfo alloc_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    alloc_info.commandPool = compute.v_command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = frame_count;
+    CHECK_VK(vkAllocateCommandBuffers(context.device.v_logical, &alloc_info, compute.v_cmds.data()));
+
+    create_queue_timeline(context, compute.timeline);
+    compute.frame_values.assign(frame_count, 0);
+}
+
+void poly::vk::destroy_async_compute(const context& context, async_compute& compute)
+{
+    destroy_queue_timeline(context, compute.timeline);
+    compute.frame_values.clear();
+
+    vkDestroyCommandPool(context.device.v_logical, compute.v_command_pool, VK_NULL_HANDLE); // Frees the command buffers with it.
+    compute.v_command_pool = VK_NULL_HANDLE;
+    compute.v_cmds.clear();
+    compute.pending = false;
+}
+
+command_buffer poly::vk::begin_async_compute(const context& context, async_compute& compute, uint32_t frame)
+{
+    compute.frame = frame % static_cast<uint32_t>(compute.v_cmds.size());
+    wait_timeline(context, compute.timeline, compute.frame_values[compute.frame]);
+
+    VkCommandBuffer cmd = compute.v_cmds[compute.frame];
+    CHECK_VK(vkResetCommandBuffer(cmd, 0));
+
+    VkCommandBufferBeginInfo info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    CHECK_VK(vkBeginCommandBuffer(cmd, &info));
+    return command_buffer{ cmd };
+}
+
+void poly::vk::submit_async_compute(const context& context, async_compute& compute, const queue_timeline& graphics, VkPipelineStageFlags graphics_wait_stages)
+{
+    VkCommandBuffer cmd = compute.v_cmds[compute.frame];
+    CHECK_VK(vkEndCommandBuffer(cmd));
+
+    const uint64_t value = next_timeline_value(compute.timeline);
+
+    // The last graphics submit may still read what the previous compute submit wrote, so writes wait for it.
+    const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    const uint64_t wait_value = graphics.submitted;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timeline_info.waitSemaphoreValueCount = 1;
+    timeline_info.pWaitSemaphoreValues = &wait_value;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &value;
+
+    VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &graphics.v_semaphore;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &compute.timeline.v_semaphore;
+
+    CHECK_VK(vkQueueSubmit(context.device.v_compute_queue, 1, &submit_info, VK_NULL_HANDLE));
+    compute.frame_values[compute.frame] = value;
+
+    compute.pending = true;
+    compute.wait_stages = graphics_wait_stages;
+}
+
+void poly::vk::record_compute_handoff(const context& context, const async_compute& compute, const command_buffer& compute_cmd, const command_buffer& graphics_cmd,
+                                      const buffer& buf, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+    if (!compute.dedicated)
+    {
+        return;
+    }
+
+    VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    barrier.srcQueueFamilyIndex = context.device.compute_queue_index;
+    barrier.dstQueueFamilyIndex = context.device.graphics_queue_index;
+    barrier.buffer = buf.value;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    // The release half ignores the destination access, and the acquire half the source access.
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(compute_cmd.buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, VK_NULL_HANDLE, 1, &barrier, 0, VK_NULL_HANDLE);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(graphics_cmd.buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stages, 0, 0, VK_NULL_HANDLE, 1, &barrier, 0, VK_NULL_HANDLE);
+}
+
+void poly::vk::record_compute_handback(const context& context, const async_compute& compute, const command_buffer& graphics_cmd, const command_buffer& compute_cmd,
+                                       const buffer& buf, VkPipelineStageFlags src_stages)
+{
+    if (!compute.dedicated)
+    {
+        return;
+    }
+
+    VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    barrier.srcQueueFamilyIndex = context.device.graphics_queue_index;
+    barrier.dstQueueFamilyIndex = context.device.compute_queue_index;
+    barrier.buffer = buf.value;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    // Graphics only read the buffer, so the release has no writes to make available.
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(graphics_cmd.buf, src_stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, VK_NULL_HANDLE, 1, &barrier, 0, VK_NULL_HANDLE);
+
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(compute_cmd.buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, VK_NULL_HANDLE, 1, &barrier, 0, VK_NULL_HANDLE);
+}
+
+// ------------------------- DISPATCH -------------------------
+
+void poly::vk::dispatch_compute(const command_buffer& command_buffer, const pipeline& pipeline, const VkExtent3D& threads, const VkExtent3D& group_size)
+{
+    vkCmdBindPipeline(command_buffer.buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.v_pipeline);
+    vkCmdDispatch(command_buffer.buf, group_count(threads.width, group_size.width), group_count(threads.height, group_size.height), group_count(threads.depth, group_size.depth));
+}
+
+void poly::vk::dispatch_compute_indirect(const command_buffer& command_buffer, const pipeline& pipeline, const buffer& args, VkDeviceSize offset)
+{
+    vkCmdBindPipeline(command_buffer.buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.v_pipeline);
+    vkCmdDispatchIndirect(command_buffer.buf, args.value, offset);
+}
@@ -20,15 +20,23 @@ void context::init(const std::string& app_name, const std::vector<const char*>&
     create_physical_device(*this);
     create_logical_device(*this);
     create_vma_allocator(*this);
+    create_pipeline_cache(*this, VULKAN_PIPELINE_CACHE_PATH);
     create_swapchain(*this);
     create_swap_image_views(*this);
     create_render_pass(*this);
     create_swap_framebuffers(*this);
     create_command_pool(*this);
+    create_upload_manager(*this, uploads, VULKAN_STAGING_RING_SIZE);
+    create_frame_allocator(*this, transient, VULKAN_FRAME_ALLOCATOR_SIZE, swapchain.max_frames_in_flight);
+    create_deletion_queue(deletions, swapchain.max_frames_in_flight);
 }
 
 void context::cleanup()
 {
+    destroy_deletion_queue(*this, deletions);
+    destroy_frame_allocator(*this, transient);
+    destroy_upload_manager(*this, uploads);
+
     vkDestroyCommandPool(device.v_logical, device.v_command_pool, VK_NULL_HANDLE);
     device.v_command_pool = VK_NULL_HANDLE;
 
@@ -36,6 +44,10 @@ void context::cleanup()
     v_render_pass = VK_NULL_HANDLE;
 
     destroy_swapchain(*this);
+    destroy_handle_caches(*this);
+
+    save_pipeline_cache(*this, VULKAN_PIPELINE_CACHE_PATH);
+    destroy_pipeline_cache(*this);
 
     vmaDestroyAllocator(this->allocator);
     allocator = VK_NULL_HANDLE;
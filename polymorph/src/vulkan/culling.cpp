@@ -0,0 +1,201 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace poly::vk;
+
+constexpr uint32_t CULL_GROUP_SIZE = 64; // local_size_x in cull.comp.
+
+constexpr uint32_t CULL_FLAG_COMPACT = 1;
+constexpr uint32_t CULL_FLAG_FIRST_INSTANCE = 2;
+
+// Matches the push constant block in cull.comp.
+struct cull_params
+{
+    glm::vec4 planes[6];
+    uint32_t  object_count;
+    uint32_t  flags;
+};
+
+// ------------------------- UTILS -------------------------
+
+// Gribb-Hartmann extraction, for a 0 to 1 depth range. Planes are normalised so the distance can be compared with a radius.
+static void extract_frustum_planes(const glm::mat4& m, glm::vec4 planes[6])
+{
+    glm::vec4 row0{ m[0][0], m[1][0], m[2][0], m[3][0] };
+    glm::vec4 row1{ m[0][1], m[1][1], m[2][1], m[3][1] };
+    glm::vec4 row2{ m[0][2], m[1][2], m[2][2], m[3][2] };
+    glm::vec4 row3{ m[0][3], m[1][3], m[2][3], m[3][3] };
+
+    planes[0] = row3 + row0; // Left.
+    planes[1] = row3 - row0; // Right.
+    planes[2] = row3 + row1; // Top.
+    planes[3] = row3 - row1; // Bottom.
+    planes[4] = row2;        // Near.
+    planes[5] = row3 - row2; // Far.
+
+    for (int i = 0; i < 6; i++)
+    {
+        float length = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+        planes[i] /= length > 0.0f ? length : 1.0f;
+    }
+}
+
+static VkDescriptorBufferInfo whole_buffer(const buffer& buf)
+{
+    return VkDescriptorBufferInfo{ buf.value, 0, VK_WHOLE_SIZE };
+}
+
+// ------------------------- GPU CULLING -------------------------
+
+void poly::vk::create_gpu_culling(const context& context, gpu_culling& culling, uint32_t capacity, const std::string& shader_path)
+{
+    culling.capacity = capacity;
+    culling.object_count = 0;
+    culling.compact = context.device.supports_draw_indirect_count;
+    culling.multi_draw = context.device.supports_multi_draw_indirect;
+
+    create_buffer(context, culling.objects, sizeof(gpu_object) * static_cast<VkDeviceSize>(capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    create_buffer(context, culling.commands, sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    create_buffer(context, culling.count, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    tag_buffer(context, culling.objects, memory_category::geometry, "culling objects");
+    tag_buffer(context, culling.commands, memory_category::geometry, "culling draw commands");
+    tag_buffer(context, culling.count, memory_category::geometry, "culling draw count");
+
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    layout_info.bindingCount = 3;
+    layout_info.pBindings = bindings;
+    CHECK_VK(vkCreateDescriptorSetLayout(context.device.v_logical, &layout_info, VK_NULL_HANDLE, &culling.v_set_layout));
+
+    VkDescriptorPoolSize pool_size{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 };
+    VkDescriptorPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    CHECK_VK(vkCreateDescriptorPool(context.device.v_logical, &pool_info, VK_NULL_HANDLE, &culling.v_descriptor_pool));
+
+    VkDescriptorSetAllocateInfo set_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    set_info.descriptorPool = culling.v_descriptor_pool;
+    set_info.descriptorSetCount = 1;
+    set_info.pSetLayouts = &culling.v_set_layout;
+    CHECK_VK(vkAllocateDescriptorSets(context.device.v_logical, &set_info, &culling.v_set));
+
+    VkDescriptorBufferInfo buffer_infos[3] = { whole_buffer(culling.objects), whole_buffer(culling.commands), whole_buffer(culling.count) };
+    VkWriteDescriptorSet writes[3]{};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = culling.v_set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    vkUpdateDescriptorSets(context.device.v_logical, 3, writes, 0, VK_NULL_HANDLE);
+
+    compute_pipeline_cfg cfg{};
+    cfg.pipeline_layout.set_layouts = { culling.v_set_layout };
+    cfg.pipeline_layout.push_const_ranges = { VkPushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(cull_params) } };
+    cfg.shader_stage.entry = "main";
+    cfg.shader_stage.module = create_shader_module(context.device.v_logical, read_file_vec_u8(shader_path));
+    cfg.shader_stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    create_compute_pipeline(context, culling.cull, cfg);
+}
+
+void poly::vk::destroy_gpu_culling(const context& context, gpu_culling& culling)
+{
+    destroy_pipeline(context, culling.cull);
+    vkDestroyDescriptorPool(context.device.v_logical, culling.v_descriptor_pool, VK_NULL_HANDLE);
+    culling.v_descriptor_pool = VK_NULL_HANDLE;
+    culling.v_set = VK_NULL_HANDLE;
+    vkDestroyDescriptorSetLayout(context.device.v_logical, culling.v_set_layout, VK_NULL_HANDLE);
+    culling.v_set_layout = VK_NULL_HANDLE;
+
+    destroy_buffer(context, culling.objects);
+    destroy_buffer(context, culling.commands);
+    destroy_buffer(context, culling.count);
+    culling.capacity = 0;
+    culling.object_count = 0;
+}
+
+gpu_object poly::vk::make_gpu_object(const mesh_range& mesh, const glm::vec3& center, float radius)
+{
+    gpu_object object{};
+    object.sphere = glm::vec4(center, radius);
+    object.index_count = mesh.index_count;
+    object.first_index = mesh.first_index;
+    object.vertex_offset = mesh.vertex_offset;
+    object.instance_count = 1;
+    return object;
+}
+
+upload_ticket poly::vk::write_gpu_objects(context& context, gpu_culling& culling, uint32_t first, uint32_t count, const gpu_object* objects)
+{
+    ASSERT_VK(first + count <= culling.capacity);
+    culling.object_count = std::max(culling.object_count, first + count);
+    return enqueue_buffer_upload(context, context.uploads, culling.objects, sizeof(gpu_object) * static_cast<VkDeviceSize>(first), sizeof(gpu_object) * static_cast<VkDeviceSize>(count), objects);
+}
+
+void poly::vk::record_gpu_culling(const command_buffer& command_buffer, const gpu_culling& culling, const glm::mat4& view_projection)
+{
+    VkCommandBuffer cmd = command_buffer.buf;
+
+    // The draws of the previous frame read the commands before this pass may overwrite them.
+    VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+    vkCmdFillBuffer(cmd, culling.count.value, 0, sizeof(uint32_t), 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+    cull_params params{};
+    extract_frustum_planes(view_projection, params.planes);
+    params.object_count = culling.object_count;
+    params.flags = (culling.compact ? CULL_FLAG_COMPACT : 0) | (culling.multi_draw ? CULL_FLAG_FIRST_INSTANCE : 0);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, culling.cull.v_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, culling.cull.v_layout, 0, 1, &culling.v_set, 0, VK_NULL_HANDLE);
+    vkCmdPushConstants(cmd, culling.cull.v_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(cmd, (culling.object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+}
+
+void poly::vk::draw_gpu_culled(const command_buffer& command_buffer, const gpu_culling& culling)
+{
+    constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    if (culling.compact)
+    {
+        vkCmdDrawIndexedIndirectCount(command_buffer.buf, culling.commands.value, 0, culling.count.value, 0, culling.object_count, stride);
+    }
+    else if (culling.multi_draw)
+    {
+        vkCmdDrawIndexedIndirect(command_buffer.buf, culling.commands.value, 0, culling.object_count, stride);
+    }
+    else
+    {
+        // Culled objects still cost a draw here, but one with no instances.
+        for (uint32_t i = 0; i < culling.object_count; i++)
+        {
+            vkCmdDrawIndexedIndirect(command_buffer.buf, culling.commands.value, static_cast<VkDeviceSize>(i) * stride, 1, stride);
+        }
+    }
+}
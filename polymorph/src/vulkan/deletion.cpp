@@ -0,0 +1,96 @@
+#include "polymorph/vulkan/context.h"
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+static void destroy_deferred(const context& context, deferred_deletion& deletion)
+{
+    switch (deletion.type)
+    {
+    case deletion_type::buffer:      destroy_buffer(context, deletion.buf); break;
+    case deletion_type::image:       destroy_image(context, deletion.img); break;
+    case deletion_type::pipeline:    destroy_pipeline(context, deletion.pipe); break;
+    case deletion_type::framebuffer: destroy_framebuffer(context, deletion.fb); break;
+    case deletion_type::mesh:
+        vmaVirtualFree(deletion.pool->vertex_block, deletion.mesh.vertex_allocation);
+        vmaVirtualFree(deletion.pool->index_block, deletion.mesh.index_allocation);
+        break;
+    }
+}
+
+static deferred_deletion& push_deferred(deletion_queue& deletions, deletion_type type)
+{
+    deferred_deletion& deletion = deletions.frames[deletions.current].emplace_back();
+    deletion = {};
+    deletion.type = type;
+    return deletion;
+}
+
+// ------------------------- DELETION QUEUE -------------------------
+
+void poly::vk::create_deletion_queue(deletion_queue& deletions, uint32_t frame_count)
+{
+    deletions.frames.resize(frame_count);
+    deletions.current = 0;
+}
+
+void poly::vk::destroy_deletion_queue(const context& context, deletion_queue& deletions)
+{
+    for (auto& frame : deletions.frames)
+    {
+        for (auto& deletion : frame)
+        {
+            destroy_deferred(context, deletion);
+        }
+    }
+    deletions.frames.clear();
+}
+
+void poly::vk::flush_deletion_queue(const context& context, deletion_queue& deletions, uint32_t frame)
+{
+    deletions.current = frame % static_cast<uint32_t>(deletions.frames.size());
+
+    auto& bucket = deletions.frames[deletions.current];
+    for (auto& deletion : bucket)
+    {
+        destroy_deferred(context, deletion);
+    }
+    bucket.clear(); // Keeps its capacity, so steady streaming does not reallocate.
+}
+
+void poly::vk::defer_destroy_buffer(context& context, buffer& buf)
+{
+    if (buf.allocation != VK_NULL_HANDLE)
+    {
+        vmaSetAllocationUserData(context.allocator, buf.allocation, nullptr); // The wrapper is emptied below, so the defragmenter must not patch it.
+    }
+    push_deferred(context.deletions, deletion_type::buffer).buf = buf;
+    buf = {};
+}
+
+void poly::vk::defer_destroy_image(context& context, image& img)
+{
+    push_deferred(context.deletions, deletion_type::image).img = img;
+    img = {};
+}
+
+void poly::vk::defer_destroy_pipeline(context& context, pipeline& pipeline)
+{
+    push_deferred(context.deletions, deletion_type::pipeline).pipe = pipeline;
+    pipeline = {};
+}
+
+void poly::vk::defer_destroy_framebuffer(context& context, framebuffer& framebuffer)
+{
+    push_deferred(context.deletions, deletion_type::framebuffer).fb = framebuffer;
+    framebuffer = {};
+}
+
+void poly::vk::defer_free_mesh(context& context, geometry_pool& pool, mesh_range& mesh)
+{
+    deferred_deletion& deletion = push_deferred(context.deletions, deletion_type::mesh);
+    deletion.pool = &pool;
+    deletion.mesh = mesh;
+    mesh = {};
+}
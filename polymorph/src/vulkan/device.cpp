@@ -2,7 +2,9 @@
 #include "polymorph/vulkan/utility.h"
 #include "polymorph/vulkan/defines.h"
 
+#include <algorithm>
 #include <set>
+#include <cstring>
 
 using namespace poly::vk;
 
@@ -24,6 +26,22 @@ static bool check_device_extension_support(context& context, const VkPhysicalDev
     return required_extensions.empty();
 }
 
+static bool is_extension_available(const VkPhysicalDevice& device, const char* extension_name)
+{
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+
+    std::vector<VkExtensionProperties> available_extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+
+    for (const auto& extension : available_extensions) {
+        if (strcmp(extension.extensionName, extension_name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static bool is_device_suitable(context& context, const VkPhysicalDevice& device, const swapchain_support_details& details)
 {
     queue_families qf = get_queue_families(device, context.v_surface);
@@ -71,6 +89,7 @@ void poly::vk::create_logical_device(context& context)
     context.device.graphics_queue_index = qf.graphics.value();
     context.device.present_queue_index = qf.present.value();
     context.device.compute_queue_index = qf.compute.value();
+    context.device.transfer_queue_index = qf.transfer.value();
 
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos {};
     std::set<uint32_t> unique_queue_families = {};
@@ -92,15 +111,129 @@ void poly::vk::create_logical_device(context& context)
         queue_create_infos.push_back(q_create_info);
     }
   
+    VkPhysicalDeviceFeatures supported_features {};
+    vkGetPhysicalDeviceFeatures(context.device.v_physical, &supported_features);
+
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(context.device.v_physical, &properties);
+
+    const bool has_synchronization2 = is_extension_available(context.device.v_physical, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    const bool has_present_wait = is_extension_available(context.device.v_physical, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+                               && is_extension_available(context.device.v_physical, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+    // Extension feature structs are only chained when the device has the extension.
+    VkPhysicalDeviceSynchronization2FeaturesKHR supported_features_sync2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+    VkPhysicalDevicePresentIdFeaturesKHR supported_features_present_id {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR};
+    VkPhysicalDevicePresentWaitFeaturesKHR supported_features_present_wait {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+    VkPhysicalDeviceVulkan12Features supported_features_12 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    void** supported_next = &supported_features_12.pNext;
+    if (has_synchronization2)
+    {
+        *supported_next = &supported_features_sync2;
+        supported_next = &supported_features_sync2.pNext;
+    }
+    if (has_present_wait)
+    {
+        *supported_next = &supported_features_present_id;
+        supported_features_present_id.pNext = &supported_features_present_wait;
+    }
+    VkPhysicalDeviceFeatures2 supported_features_2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    supported_features_2.pNext = &supported_features_12;
+    vkGetPhysicalDeviceFeatures2(context.device.v_physical, &supported_features_2);
+
     VkPhysicalDeviceFeatures pd_features {};
+    pd_features.samplerAnisotropy = supported_features.samplerAnisotropy;
+    context.device.max_sampler_anisotropy = supported_features.samplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 0.0f;
+
+    // Profiling, where pipeline statistics are optional and timestamps are unavailable on queues with no valid bits.
+    context.device.supports_pipeline_statistics = supported_features.pipelineStatisticsQuery;
+    pd_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+    context.device.timestamp_period = properties.limits.timestampPeriod;
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(context.device.v_physical, &family_count, VK_NULL_HANDLE);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(context.device.v_physical, &family_count, families.data());
+    context.device.timestamp_valid_bits = families[context.device.graphics_queue_index].timestampValidBits;
+
+    // GPU-driven drawing, which falls back to one indirect draw per object without them.
+    context.device.supports_multi_draw_indirect = supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance;
+    pd_features.multiDrawIndirect = context.device.supports_multi_draw_indirect;
+    pd_features.drawIndirectFirstInstance = context.device.supports_multi_draw_indirect;
+
+    VkPhysicalDeviceVulkan12Features pd_features_12 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    context.device.supports_draw_indirect_count = supported_features_12.drawIndirectCount && context.device.supports_multi_draw_indirect;
+    pd_features_12.drawIndirectCount = context.device.supports_draw_indirect_count;
+
+    // Frame pacing and GPU progress queries are built on timeline semaphores, which every Vulkan 1.2 desktop driver supports.
+    if (!supported_features_12.timelineSemaphore)
+    {
+        THROW_VK("timeline semaphores are unsupported");
+    }
+    pd_features_12.timelineSemaphore = VK_TRUE;
+
+    // Barriers with per-barrier stage masks, which fall back to vkCmdPipelineBarrier without it.
+    VkPhysicalDeviceSynchronization2FeaturesKHR pd_features_sync2 {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+    context.device.supports_synchronization2 = has_synchronization2 && supported_features_sync2.synchronization2;
+    pd_features_sync2.synchronization2 = context.device.supports_synchronization2;
+
+    // Observing when a present completes, for latency measurements.
+    VkPhysicalDevicePresentIdFeaturesKHR pd_features_present_id {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR};
+    VkPhysicalDevicePresentWaitFeaturesKHR pd_features_present_wait {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+    context.device.supports_present_wait = has_present_wait && supported_features_present_id.presentId && supported_features_present_wait.presentWait;
+    pd_features_present_id.presentId = context.device.supports_present_wait;
+    pd_features_present_wait.presentWait = context.device.supports_present_wait;
+
+    void** enabled_next = &pd_features_12.pNext;
+    if (context.device.supports_synchronization2)
+    {
+        *enabled_next = &pd_features_sync2;
+        enabled_next = &pd_features_sync2.pNext;
+    }
+    if (context.device.supports_present_wait)
+    {
+        *enabled_next = &pd_features_present_id;
+        pd_features_present_id.pNext = &pd_features_present_wait;
+    }
+
     VkDeviceCreateInfo device_create_info {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    device_create_info.pNext = &pd_features_12;
     device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
     device_create_info.pQueueCreateInfos = queue_create_infos.data();
   
     device_create_info.pEnabledFeatures = &pd_features;
 
-    device_create_info.enabledExtensionCount = static_cast<uint32_t>(context.requested_device_extensions.size());
-    device_create_info.ppEnabledExtensionNames = context.requested_device_extensions.data();
+    // Optional extensions, enabled only when the device has them.
+    std::vector<const char*> enabled_extensions = context.requested_device_extensions;
+    context.device.supports_memory_budget = is_extension_available(context.device.v_physical, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (context.device.supports_memory_budget) enabled_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (context.device.supports_synchronization2) enabled_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    if (context.device.supports_present_wait) enabled_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    if (context.device.supports_present_wait) enabled_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+    // Relating GPU timestamps to the CPU clock, in the one host domain std::chrono::steady_clock also reads.
+    context.device.host_time_domain = VK_TIME_DOMAIN_DEVICE_EXT;
+    if (is_extension_available(context.device.v_physical, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+    {
+#ifdef _WIN32
+        const VkTimeDomainEXT host_domain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+        const VkTimeDomainEXT host_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+        auto get_domains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(vkGetInstanceProcAddr(context.v_instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+        uint32_t domain_count = 0;
+        get_domains(context.device.v_physical, &domain_count, VK_NULL_HANDLE);
+        std::vector<VkTimeDomainEXT> domains(domain_count);
+        get_domains(context.device.v_physical, &domain_count, domains.data());
+        if (std::find(domains.begin(), domains.end(), host_domain) != domains.end())
+        {
+            context.device.host_time_domain = host_domain;
+            enabled_extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        }
+    }
+
+    device_create_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+    device_create_info.ppEnabledExtensionNames = enabled_extensions.data();
 
  #ifdef POLYMORPH_VULKAN_USE_VALIDATION
      device_create_info.enabledLayerCount = static_cast<uint32_t>(context.requested_layers.size());
@@ -111,6 +244,23 @@ void poly::vk::create_logical_device(context& context)
      vkGetDeviceQueue(context.device.v_logical, qf.graphics.value(), 0, &context.device.v_graphics_queue);
      vkGetDeviceQueue(context.device.v_logical, qf.present.value(),  0, &context.device.v_present_queue);
      vkGetDeviceQueue(context.device.v_logical, qf.compute.value(),  0, &context.device.v_compute_queue);
+     vkGetDeviceQueue(context.device.v_logical, qf.transfer.value(), 0, &context.device.v_transfer_queue);
+
+     context.device.cmd_pipeline_barrier2 = nullptr;
+     if (context.device.supports_synchronization2)
+     {
+         context.device.cmd_pipeline_barrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(context.device.v_logical, "vkCmdPipelineBarrier2KHR"));
+     }
+     context.device.get_calibrated_timestamps = nullptr;
+     if (context.device.host_time_domain != VK_TIME_DOMAIN_DEVICE_EXT)
+     {
+         context.device.get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(context.device.v_logical, "vkGetCalibratedTimestampsEXT"));
+     }
+     context.device.wait_for_present = nullptr;
+     if (context.device.supports_present_wait)
+     {
+         context.device.wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(context.device.v_logical, "vkWaitForPresentKHR"));
+     }
 }
 
 void poly::vk::create_vma_allocator(context& context)
@@ -120,6 +270,7 @@ void poly::vk::create_vma_allocator(context& context)
     allocator_info.physicalDevice = context.device.v_physical;
     allocator_info.device = context.device.v_logical;
     allocator_info.instance = context.v_instance;
+    allocator_info.flags = context.device.supports_memory_budget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0;
         
     CHECK_VK(vmaCreateAllocator(&allocator_info, &context.allocator));
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "polymorph/vulkan/context.h"
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+static VkDeviceSize index_size(VkIndexType type)
+{
+    return type == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+}
+
+static VmaVirtualBlock create_virtual_block(uint32_t element_count)
+{
+    VmaVirtualBlockCreateInfo info{};
+    info.size = element_count;
+
+    VmaVirtualBlock block;
+    CHECK_VK(vmaCreateVirtualBlock(&info, &block));
+    return block;
+}
+
+static VmaVirtualAllocation allocate_elements(VmaVirtualBlock block, uint32_t count, uint32_t& first)
+{
+    VmaVirtualAllocationCreateInfo info{};
+    info.size = count;
+
+    VmaVirtualAllocation allocation;
+    VkDeviceSize offset = 0;
+    if (vmaVirtualAllocate(block, &info, &allocation, &offset) != VK_SUCCESS)
+    {
+        THROW_VK("geometry pool is out of memory");
+    }
+    first = static_cast<uint32_t>(offset);
+    return allocation;
+}
+
+// ------------------------- GEOMETRY POOL -------------------------
+
+void poly::vk::create_geometry_pool(const context& context, geometry_pool& pool, uint32_t vertex_stride, uint32_t max_vertices, VkIndexType index_type, uint32_t max_indices)
+{
+    pool.vertex_stride = vertex_stride;
+    pool.index_type = index_type;
+
+    create_buffer(context, pool.vertices, static_cast<VkDeviceSize>(vertex_stride) * max_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    create_buffer(context, pool.indices, index_size(index_type) * max_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    tag_buffer(context, pool.vertices, memory_category::geometry, "geometry pool vertices");
+    tag_buffer(context, pool.indices, memory_category::geometry, "geometry pool indices");
+
+    pool.vertex_block = create_virtual_block(max_vertices);
+    pool.index_block = create_virtual_block(max_indices);
+}
+
+void poly::vk::destroy_geometry_pool(const context& context, geometry_pool& pool)
+{
+    vmaDestroyVirtualBlock(pool.vertex_block);
+    pool.vertex_block = VK_NULL_HANDLE;
+    vmaDestroyVirtualBlock(pool.index_block);
+    pool.index_block = VK_NULL_HANDLE;
+
+    destroy_buffer(context, pool.vertices);
+    destroy_buffer(context, pool.indices);
+}
+
+upload_ticket poly::vk::allocate_mesh(context& context, geometry_pool& pool, mesh_range& mesh, const void* vertices, uint32_t vertex_count, const void* indices, uint32_t index_count)
+{
+    uint32_t base_vertex = 0;
+    mesh.vertex_allocation = allocate_elements(pool.vertex_block, vertex_count, base_vertex);
+    mesh.vertex_offset = static_cast<int32_t>(base_vertex);
+    mesh.vertex_count = vertex_count;
+
+    try
+    {
+        mesh.index_allocation = allocate_elements(pool.index_block, index_count, mesh.first_index);
+    }
+    catch (...)
+    {
+        vmaVirtualFree(pool.vertex_block, mesh.vertex_allocation);
+        mesh = {};
+        throw;
+    }
+    mesh.index_count = index_count;
+
+    enqueue_buffer_upload(context, context.uploads, pool.vertices, static_cast<VkDeviceSize>(base_vertex) * pool.vertex_stride, static_cast<VkDeviceSize>(vertex_count) * pool.vertex_stride, vertices);
+    return enqueue_buffer_upload(context, context.uploads, pool.indices, mesh.first_index * index_size(pool.index_type), index_count * index_size(pool.index_type), indices);
+}
+
+void poly::vk::free_mesh(context& context, geometry_pool& pool, mesh_range& mesh, bool immediate)
+{
+    if (!immediate)
+    {
+        defer_free_mesh(context, pool, mesh); // A later allocation would otherwise upload over a range frames in flight still draw.
+        return;
+    }
+
+    vmaVirtualFree(pool.vertex_block, mesh.vertex_allocation);
+    vmaVirtualFree(pool.index_block, mesh.index_allocation);
+    mesh = {};
+}
+
+// ------------------------- DRAWING -------------------------
+
+void poly::vk::bind_geometry_pool(const command_buffer& cmd_buf, const geometry_pool& pool)
+{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd_buf.buf, 0, 1, &pool.vertices.value, &offset);
+    vkCmdBindIndexBuffer(cmd_buf.buf, pool.indices.value, 0, pool.index_type);
+}
+
+void poly::vk::draw_mesh(const command_buffer& cmd_buf, const mesh_range& mesh, uint32_t instance_count)
+{
+    vkCmdDrawIndexed(cmd_buf.buf, mesh.index_count, instance_count, mesh.first_index, mesh.vertex_offset, 0);
+}
+
+VkDrawIndexedIndirectCommand poly::vk::make_indirect_draw(const mesh_range& mesh, uint32_t instance_count, uint32_t first_instance)
+{
+    VkDrawIndexedIndirectCommand command{};
+    command.indexCount = mesh.index_count;
+    command.instanceCount = instance_count;
+    command.firstIndex = mesh.first_index;
+    command.vertexOffset = mesh.vertex_offset;
+    command.firstInstance = first_instance;
+    return command;
+}
@@ -1,41 +1,243 @@
 #include "polymorph/vulkan/context.h"
 
+#include <algorithm>
+
 using namespace poly::vk;
 
+struct format_block_range
+{
+    VkFormat     first;
+    VkFormat     last;
+    format_block block;
+};
+
+// Formats in each range share a block, relying on the order vulkan declares them in.
+static const format_block_range FORMAT_BLOCKS[] =
+{
+    { VK_FORMAT_R4G4_UNORM_PACK8,           VK_FORMAT_R4G4_UNORM_PACK8,           { 1, 1, 1 } },
+    { VK_FORMAT_R4G4B4A4_UNORM_PACK16,      VK_FORMAT_A1R5G5B5_UNORM_PACK16,      { 1, 1, 2 } },
+    { VK_FORMAT_R8_UNORM,                   VK_FORMAT_R8_SRGB,                    { 1, 1, 1 } },
+    { VK_FORMAT_R8G8_UNORM,                 VK_FORMAT_R8G8_SRGB,                  { 1, 1, 2 } },
+    { VK_FORMAT_R8G8B8_UNORM,               VK_FORMAT_B8G8R8_SRGB,                { 1, 1, 3 } },
+    { VK_FORMAT_R8G8B8A8_UNORM,             VK_FORMAT_A2B10G10R10_SINT_PACK32,    { 1, 1, 4 } },
+    { VK_FORMAT_R16_UNORM,                  VK_FORMAT_R16_SFLOAT,                 { 1, 1, 2 } },
+    { VK_FORMAT_R16G16_UNORM,               VK_FORMAT_R16G16_SFLOAT,              { 1, 1, 4 } },
+    { VK_FORMAT_R16G16B16_UNORM,            VK_FORMAT_R16G16B16_SFLOAT,           { 1, 1, 6 } },
+    { VK_FORMAT_R16G16B16A16_UNORM,         VK_FORMAT_R16G16B16A16_SFLOAT,        { 1, 1, 8 } },
+    { VK_FORMAT_R32_UINT,                   VK_FORMAT_R32_SFLOAT,                 { 1, 1, 4 } },
+    { VK_FORMAT_R32G32_UINT,                VK_FORMAT_R32G32_SFLOAT,              { 1, 1, 8 } },
+    { VK_FORMAT_R32G32B32_UINT,             VK_FORMAT_R32G32B32_SFLOAT,           { 1, 1, 12 } },
+    { VK_FORMAT_R32G32B32A32_UINT,          VK_FORMAT_R32G32B32A32_SFLOAT,        { 1, 1, 16 } },
+    { VK_FORMAT_R64_UINT,                   VK_FORMAT_R64_SFLOAT,                 { 1, 1, 8 } },
+    { VK_FORMAT_R64G64_UINT,                VK_FORMAT_R64G64_SFLOAT,              { 1, 1, 16 } },
+    { VK_FORMAT_R64G64B64_UINT,             VK_FORMAT_R64G64B64_SFLOAT,           { 1, 1, 24 } },
+    { VK_FORMAT_R64G64B64A64_UINT,          VK_FORMAT_R64G64B64A64_SFLOAT,        { 1, 1, 32 } },
+    { VK_FORMAT_B10G11R11_UFLOAT_PACK32,    VK_FORMAT_E5B9G9R9_UFLOAT_PACK32,     { 1, 1, 4 } },
+    { VK_FORMAT_D16_UNORM,                  VK_FORMAT_D16_UNORM,                  { 1, 1, 2 } },
+    { VK_FORMAT_X8_D24_UNORM_PACK32,        VK_FORMAT_D32_SFLOAT,                 { 1, 1, 4 } },
+    { VK_FORMAT_S8_UINT,                    VK_FORMAT_S8_UINT,                    { 1, 1, 1 } },
+    { VK_FORMAT_BC1_RGB_UNORM_BLOCK,        VK_FORMAT_BC1_RGBA_SRGB_BLOCK,        { 4, 4, 8 } },
+    { VK_FORMAT_BC2_UNORM_BLOCK,            VK_FORMAT_BC3_SRGB_BLOCK,             { 4, 4, 16 } },
+    { VK_FORMAT_BC4_UNORM_BLOCK,            VK_FORMAT_BC4_SNORM_BLOCK,            { 4, 4, 8 } },
+    { VK_FORMAT_BC5_UNORM_BLOCK,            VK_FORMAT_BC7_SRGB_BLOCK,             { 4, 4, 16 } },
+    { VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,    VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK,   { 4, 4, 8 } },
+    { VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,  VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK,   { 4, 4, 16 } },
+    { VK_FORMAT_EAC_R11_UNORM_BLOCK,        VK_FORMAT_EAC_R11_SNORM_BLOCK,        { 4, 4, 8 } },
+    { VK_FORMAT_EAC_R11G11_UNORM_BLOCK,     VK_FORMAT_EAC_R11G11_SNORM_BLOCK,     { 4, 4, 16 } },
+};
+
+// Every ASTC block is 16 bytes, over these extents.
+static const uint32_t ASTC_BLOCK_EXTENTS[][2] =
+{
+    { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+};
+
+// ------------------------- UTILS -------------------------
+
+static uint32_t full_mip_count(const VkExtent3D& extent)
+{
+    uint32_t largest = std::max({ extent.width, extent.height, extent.depth });
+    uint32_t count = 1;
+    while (largest > 1)
+    {
+        largest >>= 1;
+        count++;
+    }
+    return count;
+}
+
+static VkImageViewType view_type(const image& img)
+{
+    if (img.extent.depth > 1)
+    {
+        return VK_IMAGE_VIEW_TYPE_3D;
+    }
+    return img.array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+}
+
+// ------------------------- IMAGE CONFIG -------------------------
+
+image_cfg image_cfg::texture(VkFormat format, uint32_t width, uint32_t height, uint32_t array_layers)
+{
+    image_cfg cfg{};
+    cfg.type = VK_IMAGE_TYPE_2D;
+    cfg.format = format;
+    cfg.extent = { width, height, 1 };
+    cfg.mip_levels = 0;
+    cfg.array_layers = array_layers;
+    cfg.samples = VK_SAMPLE_COUNT_1_BIT;
+    cfg.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    cfg.flags = 0;
+    cfg.memory_props = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    cfg.category = memory_category::texture;
+    return cfg;
+}
+
 // ------------------------- IMAGE -------------------------
 
+void poly::vk::create_image(const context& context, image& img, const image_cfg& cfg)
+{
+    img.format = cfg.format;
+    img.extent = cfg.extent;
+    img.mip_levels = cfg.mip_levels == 0 ? full_mip_count(cfg.extent) : cfg.mip_levels;
+    img.array_layers = std::max(1u, cfg.array_layers);
+    img.category = cfg.category;
+    img.state = {};
+
+    VkImageCreateInfo info{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    info.flags = cfg.flags;
+    info.imageType = cfg.type;
+    info.format = cfg.format;
+    info.extent = cfg.extent;
+    info.mipLevels = img.mip_levels;
+    info.arrayLayers = img.array_layers;
+    info.samples = cfg.samples;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = cfg.usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_AUTO;
+    allocation_info.requiredFlags = cfg.memory_props;
+
+    VmaAllocationInfo result{};
+    CHECK_VK(vmaCreateImage(context.allocator, &info, &allocation_info, &img.v_image, &img.allocation, &result));
+    track_allocation(context, img.category, result.size);
+}
+
+upload_ticket poly::vk::create_texture(context& context, image& img, const image_cfg& cfg, VkDeviceSize size, const void* data)
+{
+    // A full chain is only the default, so formats which cannot be blitted get their top level alone.
+    image_cfg texture_cfg = cfg;
+    if (texture_cfg.mip_levels == 0 && !supports_mip_generation(context, cfg.format))
+    {
+        texture_cfg.mip_levels = 1;
+    }
+
+    create_image(context, img, texture_cfg);
+    create_image_view(context, img, cfg.format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    VkImageSubresourceLayers top{};
+    top.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    top.mipLevel = 0;
+    top.baseArrayLayer = 0;
+    top.layerCount = img.array_layers;
+
+    if (img.mip_levels == 1)
+    {
+        return enqueue_image_upload(context, context.uploads, img, top, img.extent, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, size, data);
+    }
+
+    enqueue_image_upload(context, context.uploads, img, top, img.extent, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, size, data);
+    return enqueue_mip_generation(context, context.uploads, img, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
 void poly::vk::create_image_view(const context& context, image& image, VkFormat format, VkImageAspectFlags aspect_flags)
 {
     VkImageViewCreateInfo info{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
     info.format = format;
     info.image = image.v_image;
-    info.viewType = VK_IMAGE_VIEW_TYPE_2D; // TODO: make configurable
+    info.viewType = view_type(image);
     info.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY }; // TODO: make configurable
 
     info.subresourceRange.aspectMask = aspect_flags;
     info.subresourceRange.baseMipLevel = 0;
-    info.subresourceRange.levelCount = 1;
+    info.subresourceRange.levelCount = std::max(1u, image.mip_levels); // Wrappers around foreign images, like swapchain images, leave these empty.
     info.subresourceRange.baseArrayLayer = 0;
-    info.subresourceRange.layerCount = 1;
+    info.subresourceRange.layerCount = std::max(1u, image.array_layers);
+
+    image.v_view = acquire_image_view(context, info); // Shared with any identical view of the image.
+}
+
+VkImageAspectFlags poly::vk::get_format_aspect(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
 
-    CHECK_VK(vkCreateImageView(context.device.v_logical, &info, VK_NULL_HANDLE, &image.v_view));
+format_block poly::vk::get_format_block(VkFormat format)
+{
+    for (const auto& range : FORMAT_BLOCKS)
+    {
+        if (format >= range.first && format <= range.last)
+        {
+            return range.block;
+        }
+    }
+
+    if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+    {
+        const uint32_t* extent = ASTC_BLOCK_EXTENTS[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2]; // Each extent has a UNORM and an SRGB format.
+        return { extent[0], extent[1], 16 };
+    }
+    return { 1, 1, 0 };
+}
+
+bool poly::vk::supports_mip_generation(const context& context, VkFormat format)
+{
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(context.device.v_physical, format, &properties);
+
+    constexpr VkFormatFeatureFlags BLIT_FEATURES = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    return (properties.optimalTilingFeatures & BLIT_FEATURES) == BLIT_FEATURES;
 }
 
 void poly::vk::destroy_image(const context& context, image& image)
 {
     if (image.v_view != VK_NULL_HANDLE)
     {
-        vkDestroyImageView(context.device.v_logical, image.v_view, VK_NULL_HANDLE);
+        release_image_view(context, image.v_view);
         image.v_view = VK_NULL_HANDLE;
     }
-    if (image.v_image != VK_NULL_HANDLE)
+    if (image.allocation != VK_NULL_HANDLE)
     {
-        vkDestroyImage(context.device.v_logical, image.v_image, VK_NULL_HANDLE);
+        VmaAllocationInfo allocation_info{};
+        vmaGetAllocationInfo(context.allocator, image.allocation, &allocation_info);
+        track_free(context, image.category, allocation_info.size);
+
+        vmaDestroyImage(context.allocator, image.v_image, image.allocation);
+        image.allocation = VK_NULL_HANDLE;
         image.v_image = VK_NULL_HANDLE;
     }
-    if (image.v_memory != VK_NULL_HANDLE)
+    else if (image.v_image != VK_NULL_HANDLE)
     {
-        vkFreeMemory(context.device.v_logical, image.v_memory, VK_NULL_HANDLE);
-        image.v_memory = VK_NULL_HANDLE;
+        vkDestroyImage(context.device.v_logical, image.v_image, VK_NULL_HANDLE);
+        image.v_image = VK_NULL_HANDLE;
     }
-}
\ No newline at end of file
+    image.mip_levels = 0;
+    image.array_layers = 0;
+}
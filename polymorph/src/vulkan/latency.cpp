@@ -0,0 +1,87 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace poly::vk;
+
+constexpr float LATENCY_AVERAGE_WEIGHT = 0.05f;
+
+// ------------------------- UTILS -------------------------
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void add_sample(latency_stats& stats, float ms)
+{
+    stats.last_ms = ms;
+    stats.average_ms = stats.samples == 0 ? ms : stats.average_ms + (ms - stats.average_ms) * LATENCY_AVERAGE_WEIGHT;
+    stats.max_ms = std::max(stats.max_ms, ms);
+    stats.samples++;
+}
+
+static float elapsed_ms(const frame_latency& latency, uint64_t frame_number, int64_t now)
+{
+    return static_cast<float>(now - latency.submit_ns[frame_number % FRAME_LATENCY_HISTORY]) * 1e-6f;
+}
+
+// Frames older than the history have had their submit time overwritten, so they are no longer measured.
+static uint64_t oldest_measurable(uint64_t pending, uint64_t next_frame)
+{
+    return next_frame > FRAME_LATENCY_HISTORY ? std::max(pending, next_frame - FRAME_LATENCY_HISTORY) : pending;
+}
+
+// ------------------------- FRAME LATENCY -------------------------
+
+void poly::vk::update_frame_latency(const context& context, synchron& sync)
+{
+    frame_latency& latency = sync.latency;
+    const int64_t now = now_ns();
+
+    latency.gpu_pending = oldest_measurable(latency.gpu_pending, sync.frame_number);
+    const uint64_t finished = get_timeline_value(context, sync.graphics);
+    for (; latency.gpu_pending <= finished && latency.gpu_pending < sync.frame_number; latency.gpu_pending++)
+    {
+        add_sample(latency.gpu, elapsed_ms(latency, latency.gpu_pending, now));
+    }
+
+    if (context.device.wait_for_present == nullptr)
+    {
+        return;
+    }
+
+    latency.present_pending = oldest_measurable(latency.present_pending, sync.frame_number);
+    while (latency.present_pending < sync.frame_number)
+    {
+        VkResult result = context.device.wait_for_present(context.device.v_logical, context.swapchain.v_swapchain, latency.present_pending, 0);
+        if (result == VK_TIMEOUT)
+        {
+            break;
+        }
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        {
+            latency.present_pending = sync.frame_number; // The swapchain is out of date, so its presents will never be seen.
+            break;
+        }
+        add_sample(latency.present, elapsed_ms(latency, latency.present_pending, now));
+        latency.present_pending++;
+    }
+}
+
+void poly::vk::mark_frame_submitted(frame_latency& latency, uint64_t frame_number)
+{
+    latency.submit_ns[frame_number % FRAME_LATENCY_HISTORY] = now_ns();
+}
+
+void poly::vk::skip_frame_presents(frame_latency& latency, uint64_t frame_number)
+{
+    latency.present_pending = std::max(latency.present_pending, frame_number);
+}
+
+void poly::vk::reset_frame_latency(frame_latency& latency)
+{
+    latency.gpu = {};
+    latency.present = {};
+}
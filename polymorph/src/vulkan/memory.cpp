@@ -0,0 +1,333 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+static void stop_defragmentation(const context& context, defragmenter& defrag)
+{
+    vmaEndDefragmentation(context.allocator, defrag.v_context, VK_NULL_HANDLE);
+    defrag.v_context = VK_NULL_HANDLE;
+    defrag.active = false;
+}
+
+// Only once nothing can read the old regions any more, as VMA hands them straight to new allocations.
+static void complete_pass(const context& context, defragmenter& defrag)
+{
+    defrag.pass_in_flight = false;
+    if (vmaEndDefragmentationPass(context.allocator, defrag.v_context, &defrag.pass) == VK_SUCCESS)
+    {
+        stop_defragmentation(context, defrag);
+    }
+}
+
+static void record_move(context& context, defragmenter& defrag, VmaDefragmentationMove& move, buffer& owner)
+{
+    VkBufferCreateInfo buf_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    buf_info.size = owner.size;
+    buf_info.usage = owner.usage;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer moved;
+    CHECK_VK(vkCreateBuffer(context.device.v_logical, &buf_info, VK_NULL_HANDLE, &moved));
+    CHECK_VK(vmaBindBufferMemory(context.allocator, move.dstTmpAllocation, moved));
+
+    VkBufferCopy region{};
+    region.size = owner.size;
+    vkCmdCopyBuffer(defrag.v_cmd, owner.value, moved, 1, &region);
+
+    // Frames in flight may still use the old handle. Its memory stays with the source allocation, so only the handle goes.
+    buffer retired{};
+    retired.value = owner.value;
+    defer_destroy_buffer(context, retired);
+
+    defrag.pending.push_back(&owner);
+    owner.value = moved;
+}
+
+// ------------------------- STATISTICS -------------------------
+
+void poly::vk::track_allocation(const context& context, memory_category category, VkDeviceSize size)
+{
+    const uint32_t i = static_cast<uint32_t>(category);
+    context.stats.counts[i].fetch_add(1, std::memory_order_relaxed);
+    const uint64_t bytes = context.stats.bytes[i].fetch_add(size, std::memory_order_relaxed) + size;
+
+    uint64_t peak = context.stats.peak_bytes[i].load(std::memory_order_relaxed);
+    while (bytes > peak && !context.stats.peak_bytes[i].compare_exchange_weak(peak, bytes, std::memory_order_relaxed));
+}
+
+void poly::vk::track_free(const context& context, memory_category category, VkDeviceSize size)
+{
+    const uint32_t i = static_cast<uint32_t>(category);
+    context.stats.counts[i].fetch_sub(1, std::memory_order_relaxed);
+    context.stats.bytes[i].fetch_sub(size, std::memory_order_relaxed);
+}
+
+void poly::vk::tag_buffer(const context& context, buffer& buf, memory_category category, const char* name)
+{
+    vmaSetAllocationName(context.allocator, buf.allocation, name);
+
+    if (buf.category != category)
+    {
+        VmaAllocationInfo info{};
+        vmaGetAllocationInfo(context.allocator, buf.allocation, &info);
+        track_free(context, buf.category, info.size);
+        track_allocation(context, category, info.size);
+        buf.category = category;
+    }
+}
+
+const char* poly::vk::get_memory_category_name(memory_category category)
+{
+    switch (category)
+    {
+    case memory_category::general:       return "general";
+    case memory_category::geometry:      return "geometry";
+    case memory_category::texture:       return "texture";
+    case memory_category::staging:       return "staging";
+    case memory_category::transient:     return "transient";
+    case memory_category::render_target: return "render_target";
+    default:                             return "unknown";
+    }
+}
+
+memory_report poly::vk::get_memory_report(const context& context)
+{
+    memory_report report{};
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        report.categories[i].allocation_count = context.stats.counts[i].load(std::memory_order_relaxed);
+        report.categories[i].bytes = context.stats.bytes[i].load(std::memory_order_relaxed);
+        report.categories[i].peak_bytes = context.stats.peak_bytes[i].load(std::memory_order_relaxed);
+    }
+
+    const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+    vmaGetMemoryProperties(context.allocator, &properties);
+
+    VmaTotalStatistics totals{};
+    vmaCalculateStatistics(context.allocator, &totals);
+
+    report.types.resize(properties->memoryTypeCount);
+    for (uint32_t i = 0; i < properties->memoryTypeCount; i++)
+    {
+        const VmaDetailedStatistics& detailed = totals.memoryType[i];
+        memory_type_stats& type = report.types[i];
+
+        type.heap_index = properties->memoryTypes[i].heapIndex;
+        type.flags = properties->memoryTypes[i].propertyFlags;
+        type.block_count = detailed.statistics.blockCount;
+        type.allocation_count = detailed.statistics.allocationCount;
+        type.block_bytes = detailed.statistics.blockBytes;
+        type.allocation_bytes = detailed.statistics.allocationBytes;
+
+        // How much of the free memory lies outside the largest free range.
+        VkDeviceSize unused = type.block_bytes - type.allocation_bytes;
+        type.fragmentation = unused > 0 && detailed.unusedRangeCount > 1 ? 1.0f - static_cast<float>(detailed.unusedRangeSizeMax) / static_cast<float>(unused) : 0.0f;
+    }
+    return report;
+}
+
+std::string poly::vk::dump_memory_stats(const context& context, bool detailed)
+{
+    char* json = nullptr;
+    vmaBuildStatsString(context.allocator, &json, detailed ? VK_TRUE : VK_FALSE);
+    std::string result = json;
+    vmaFreeStatsString(context.allocator, json);
+    return result;
+}
+
+// ------------------------- BUDGET -------------------------
+
+void poly::vk::update_memory_budget(const context& context, memory_budget& budget)
+{
+    vmaSetCurrentFrameIndex(context.allocator, ++budget.frame_index);
+
+    const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+    vmaGetMemoryProperties(context.allocator, &properties);
+    budget.heap_count = properties->memoryHeapCount;
+
+    vmaGetHeapBudgets(context.allocator, budget.heaps);
+}
+
+float poly::vk::get_memory_pressure(const memory_budget& budget)
+{
+    float pressure = 0.0f;
+    for (uint32_t i = 0; i < budget.heap_count; i++)
+    {
+        if (budget.heaps[i].budget > 0)
+        {
+            pressure = std::max(pressure, static_cast<float>(budget.heaps[i].usage) / static_cast<float>(budget.heaps[i].budget));
+        }
+    }
+    return pressure;
+}
+
+// ------------------------- DEFRAGMENTATION -------------------------
+
+void poly::vk::create_defragmenter(const context& context, defragmenter& defrag)
+{
+    VkCommandPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = context.device.graphics_queue_index;
+    CHECK_VK(vkCreateCommandPool(context.device.v_logical, &pool_info, VK_NULL_HANDLE, &defrag.v_command_pool));
+
+    VkCommandBufferAllocateInfo cmd_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    cmd_info.commandPool = defrag.v_command_pool;
+    cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_info.commandBufferCount = 1;
+    CHECK_VK(vkAllocateCommandBuffers(context.device.v_logical, &cmd_info, &defrag.v_cmd));
+
+    defrag.v_context = VK_NULL_HANDLE;
+    defrag.active = false;
+    defrag.pass_in_flight = false;
+    defrag.pass_frame = 0;
+}
+
+void poly::vk::destroy_defragmenter(const context& context, defragmenter& defrag)
+{
+    // The device is idle, so a pass in flight has nothing left reading its old regions.
+    if (defrag.pass_in_flight)
+    {
+        complete_pass(context, defrag);
+    }
+    if (defrag.active)
+    {
+        stop_defragmentation(context, defrag);
+    }
+    defrag.moved.clear();
+
+    vkDestroyCommandPool(context.device.v_logical, defrag.v_command_pool, VK_NULL_HANDLE);
+    defrag.v_command_pool = VK_NULL_HANDLE;
+    defrag.v_cmd = VK_NULL_HANDLE;
+}
+
+void poly::vk::set_buffer_movable(const context& context, buffer& buf)
+{
+    ASSERT_VK(buf.mapped == nullptr);
+    ASSERT_VK((buf.usage & (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)) == (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+
+    vmaSetAllocationUserData(context.allocator, buf.allocation, &buf); // Allocations without user data are never moved.
+}
+
+void poly::vk::begin_defragmentation(const context& context, defragmenter& defrag, VkDeviceSize max_bytes_per_pass)
+{
+    if (defrag.active)
+    {
+        return;
+    }
+
+    VmaDefragmentationInfo info{};
+    info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    info.maxBytesPerPass = max_bytes_per_pass;
+
+    CHECK_VK(vmaBeginDefragmentation(context.allocator, &info, &defrag.v_context));
+    defrag.max_bytes_per_pass = max_bytes_per_pass;
+    defrag.active = true;
+    defrag.pass_in_flight = false;
+    defrag.moved.clear();
+}
+
+bool poly::vk::step_defragmentation(context& context, defragmenter& defrag, const synchron& sync, double budget_ms)
+{
+    defrag.moved.clear();
+    if (!defrag.active)
+    {
+        return true;
+    }
+
+    if (defrag.pass_in_flight)
+    {
+        // Frames recorded before the moves were published may still reach the old regions through stale descriptors.
+        if (!is_frame_finished(context, sync, defrag.pass_frame))
+        {
+            return false;
+        }
+        complete_pass(context, defrag);
+        return !defrag.active;
+    }
+
+    // Pending uploads were recorded against the current handles, so nothing may move until they land.
+    if (!is_upload_complete(context, context.uploads, upload_ticket{ context.uploads.batches[context.uploads.current].id }))
+    {
+        return false;
+    }
+
+    if (vmaBeginDefragmentationPass(context.allocator, defrag.v_context, &defrag.pass) == VK_SUCCESS)
+    {
+        stop_defragmentation(context, defrag);
+        return true;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto budget = std::chrono::duration<double, std::milli>(budget_ms);
+
+    VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    CHECK_VK(vkBeginCommandBuffer(defrag.v_cmd, &begin_info));
+
+    // Earlier frames may still be reading or writing the buffers about to be copied.
+    VkMemoryBarrier before{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    before.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    before.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(defrag.v_cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+    for (uint32_t i = 0; i < defrag.pass.moveCount; i++)
+    {
+        VmaDefragmentationMove& move = defrag.pass.pMoves[i];
+
+        VmaAllocationInfo allocation_info{};
+        vmaGetAllocationInfo(context.allocator, move.srcAllocation, &allocation_info);
+
+        // Always make progress on the first move, ignore the rest once the budget is spent.
+        bool over_budget = !defrag.pending.empty() && std::chrono::steady_clock::now() - start > budget;
+        if (allocation_info.pUserData == nullptr || over_budget)
+        {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        record_move(context, defrag, move, *static_cast<buffer*>(allocation_info.pUserData));
+    }
+
+    VkMemoryBarrier after{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    after.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(defrag.v_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &after, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+    CHECK_VK(vkEndCommandBuffer(defrag.v_cmd));
+
+    if (defrag.pending.empty())
+    {
+        complete_pass(context, defrag);
+        return !defrag.active;
+    }
+
+    // Submitted ahead of the frame, and published at once, so the frame being recorded already reads the new handles.
+    VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &defrag.v_cmd;
+
+    CHECK_VK(vkQueueSubmit(context.device.v_graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+    defrag.moved.swap(defrag.pending);
+    defrag.pass_frame = sync.frame_number; // Its timeline value also covers the copies, submitted before it on the same queue.
+    defrag.pass_in_flight = true;
+    return false;
+}
+
+void poly::vk::end_defragmentation(const context& context, defragmenter& defrag, const synchron& sync)
+{
+    if (defrag.pass_in_flight)
+    {
+        wait_for_frame(context, sync, defrag.pass_frame);
+        complete_pass(context, defrag);
+    }
+
+    if (defrag.active)
+    {
+        stop_defragmentation(context, defrag);
+    }
+}
@@ -0,0 +1,89 @@
+#include "polymorph/vulkan/context.h"
+
+using namespace poly::vk;
+
+// ------------------------- THREAD COMMAND POOLS -------------------------
+
+void poly::vk::create_thread_command_pools(const context& context, thread_command_pools& pools, uint32_t thread_count, uint32_t frame_count)
+{
+    pools.thread_count = thread_count;
+    pools.frame = 0;
+
+    // Transient, since every buffer is rerecorded each frame, and reset as a whole pool rather than per buffer.
+    VkCommandPoolCreateInfo info{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    info.queueFamilyIndex = context.device.graphics_queue_index;
+
+    pools.pools.resize(static_cast<size_t>(thread_count) * frame_count);
+    for (auto& pool : pools.pools)
+    {
+        CHECK_VK(vkCreateCommandPool(context.device.v_logical, &info, VK_NULL_HANDLE, &pool));
+    }
+    pools.secondaries.resize(pools.pools.size());
+    pools.used.assign(pools.pools.size(), 0);
+    pools.recorded.reserve(thread_count);
+}
+
+void poly::vk::destroy_thread_command_pools(const context& context, thread_command_pools& pools)
+{
+    for (auto pool : pools.pools)
+    {
+        vkDestroyCommandPool(context.device.v_logical, pool, VK_NULL_HANDLE); // Frees the buffers allocated from it.
+    }
+    pools.pools.clear();
+    pools.secondaries.clear();
+    pools.used.clear();
+    pools.recorded.clear();
+}
+
+void poly::vk::reset_thread_command_pools(const context& context, thread_command_pools& pools, uint32_t frame)
+{
+    pools.frame = frame % static_cast<uint32_t>(pools.pools.size() / pools.thread_count);
+
+    for (uint32_t thread = 0; thread < pools.thread_count; thread++)
+    {
+        const uint32_t index = pools.frame * pools.thread_count + thread;
+        CHECK_VK(vkResetCommandPool(context.device.v_logical, pools.pools[index], 0));
+        pools.used[index] = 0;
+    }
+}
+
+command_buffer poly::vk::begin_secondary_commands(const context& context, thread_command_pools& pools, uint32_t thread, VkRenderPass render_pass, uint32_t subpass, const framebuffer& framebuffer)
+{
+    const uint32_t index = pools.frame * pools.thread_count + thread;
+    auto& secondaries = pools.secondaries[index];
+
+    // Buffers are only allocated the first time a thread needs more of them than before.
+    if (pools.used[index] == secondaries.size())
+    {
+        VkCommandBufferAllocateInfo alloc_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        alloc_info.commandPool = pools.pools[index];
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer buf;
+        CHECK_VK(vkAllocateCommandBuffers(context.device.v_logical, &alloc_info, &buf));
+        secondaries.push_back(buf);
+    }
+    command_buffer cmd_buf{ secondaries[pools.used[index]++] };
+
+    VkCommandBufferInheritanceInfo inheritance{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    inheritance.renderPass = render_pass;
+    inheritance.subpass = subpass;
+    inheritance.framebuffer = framebuffer.buf;
+
+    VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+    CHECK_VK(vkBeginCommandBuffer(cmd_buf.buf, &begin_info));
+
+    return cmd_buf;
+}
+
+void poly::vk::execute_secondary_commands(const command_buffer& cmd_buf, const VkCommandBuffer* secondaries, uint32_t count)
+{
+    if (count > 0)
+    {
+        vkCmdExecuteCommands(cmd_buf.buf, count, secondaries);
+    }
+}
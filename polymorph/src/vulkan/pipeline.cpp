@@ -5,6 +5,7 @@ using namespace poly::vk;
 
 void poly::vk::create_graphics_pipeline(const context& context, pipeline& pipeline, const gfx_pipeline_cfg& spec)
 {
+    POLY_TRACE_ZONE("create_graphics_pipeline");
     VkPipelineDynamicStateCreateInfo dynamic_state_info{};
     dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
     dynamic_state_info.dynamicStateCount = static_cast<uint32_t>(spec.dynamic_states.size());
@@ -115,7 +116,10 @@ void poly::vk::create_graphics_pipeline(const context& context, pipeline& pipeli
     pipeline_info.pColorBlendState = &color_blend_state_info;
     pipeline_info.pDynamicState = &dynamic_state_info;
 
-    assert(vkCreateGraphicsPipelines(context.device.v_logical, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline.v_pipeline) == VK_SUCCESS);
+    {
+        POLY_TRACE_ZONE("compile pipeline");
+        CHECK_VK(vkCreateGraphicsPipelines(context.device.v_logical, context.v_pipeline_cache, 1, &pipeline_info, VK_NULL_HANDLE, &pipeline.v_pipeline));
+    }
 
     for (const auto& stage : spec.shader_stages)
     {
@@ -125,6 +129,35 @@ void poly::vk::create_graphics_pipeline(const context& context, pipeline& pipeli
     pipeline.v_bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
 }
 
+void poly::vk::create_compute_pipeline(const context& context, pipeline& pipeline, const compute_pipeline_cfg& spec)
+{
+    POLY_TRACE_ZONE("create_compute_pipeline");
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(spec.pipeline_layout.set_layouts.size());
+    pipeline_layout_info.pSetLayouts = spec.pipeline_layout.set_layouts.data();
+    pipeline_layout_info.pushConstantRangeCount = static_cast<uint32_t>(spec.pipeline_layout.push_const_ranges.size());
+    pipeline_layout_info.pPushConstantRanges = spec.pipeline_layout.push_const_ranges.data();
+
+    CHECK_VK(vkCreatePipelineLayout(context.device.v_logical, &pipeline_layout_info, VK_NULL_HANDLE, &pipeline.v_layout));
+
+    VkComputePipelineCreateInfo pipeline_info{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = spec.shader_stage.module;
+    pipeline_info.stage.pName = spec.shader_stage.entry.c_str();
+    pipeline_info.layout = pipeline.v_layout;
+
+    {
+        POLY_TRACE_ZONE("compile pipeline");
+        CHECK_VK(vkCreateComputePipelines(context.device.v_logical, context.v_pipeline_cache, 1, &pipeline_info, VK_NULL_HANDLE, &pipeline.v_pipeline));
+    }
+
+    vkDestroyShaderModule(context.device.v_logical, spec.shader_stage.module, nullptr);
+
+    pipeline.v_bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+}
+
 void poly::vk::create_raytracing_pipeline(const context&, pipeline& pipeline)
 {
 
@@ -132,6 +165,7 @@ void poly::vk::create_raytracing_pipeline(const context&, pipeline& pipeline)
 
 VkShaderModule poly::vk::create_shader_module(VkDevice device, const std::vector<char>& source)
 {
+    POLY_TRACE_ZONE("create_shader_module");
     VkShaderModuleCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     info.codeSize = source.size();
@@ -0,0 +1,167 @@
+#include "polymorph/vulkan/context.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace poly::vk;
+
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504c50; // "PLPC"
+constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// Prefixed to the driver's blob. The driver version is not part of the vulkan header, and drivers have been known
+// to crash on blobs from an older version of themselves rather than reject them.
+struct pipeline_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint32_t reserved;
+    uint64_t data_size;
+    uint64_t data_hash;
+    uint8_t  uuid[VK_UUID_SIZE];
+};
+
+// ------------------------- UTILS -------------------------
+
+// FNV-1a, so a truncated or corrupted blob is never handed to the driver.
+static uint64_t hash_data(const char* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static pipeline_cache_header make_header(const VkPhysicalDeviceProperties& properties, const char* data, size_t size)
+{
+    pipeline_cache_header header{};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendor_id = properties.vendorID;
+    header.device_id = properties.deviceID;
+    header.driver_version = properties.driverVersion;
+    header.data_size = size;
+    header.data_hash = hash_data(data, size);
+    memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+// Checks both our header and the one the driver wrote at the start of its blob.
+static bool is_valid_cache(const VkPhysicalDeviceProperties& properties, const std::vector<char>& file)
+{
+    if (file.size() < sizeof(pipeline_cache_header) + sizeof(VkPipelineCacheHeaderVersionOne))
+    {
+        return false;
+    }
+
+    pipeline_cache_header header;
+    memcpy(&header, file.data(), sizeof(header));
+    const char* data = file.data() + sizeof(header);
+    const size_t size = file.size() - sizeof(header);
+
+    pipeline_cache_header expected = make_header(properties, data, size);
+    if (header.magic != expected.magic || header.version != expected.version
+        || header.vendor_id != expected.vendor_id || header.device_id != expected.device_id || header.driver_version != expected.driver_version
+        || memcmp(header.uuid, expected.uuid, VK_UUID_SIZE) != 0 || header.data_size != size || header.data_hash != expected.data_hash)
+    {
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne driver_header;
+    memcpy(&driver_header, data, sizeof(driver_header));
+    return driver_header.headerSize >= sizeof(driver_header) && driver_header.headerSize <= size && driver_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && driver_header.vendorID == properties.vendorID && driver_header.deviceID == properties.deviceID
+        && memcmp(driver_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static std::vector<char> read_cache_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+    {
+        return {}; // Not saved yet, which is expected on the first run.
+    }
+
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), buffer.size());
+    if (!file)
+    {
+        buffer.clear();
+    }
+    return buffer;
+}
+
+// ------------------------- PIPELINE CACHE -------------------------
+
+void poly::vk::create_pipeline_cache(context& context, const std::string& path)
+{
+    POLY_TRACE_ZONE("create_pipeline_cache");
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(context.device.v_physical, &properties);
+
+    std::vector<char> file = read_cache_file(path);
+    VkPipelineCacheCreateInfo cache_info{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    if (is_valid_cache(properties, file))
+    {
+        cache_info.initialDataSize = file.size() - sizeof(pipeline_cache_header);
+        cache_info.pInitialData = file.data() + sizeof(pipeline_cache_header);
+    }
+    else if (!file.empty())
+    {
+        printf("Pipeline cache '%s' is stale or corrupt, starting empty\n", path.c_str());
+    }
+
+    CHECK_VK(vkCreatePipelineCache(context.device.v_logical, &cache_info, VK_NULL_HANDLE, &context.v_pipeline_cache));
+}
+
+bool poly::vk::save_pipeline_cache(const context& context, const std::string& path)
+{
+    POLY_TRACE_ZONE("save_pipeline_cache");
+    size_t size = 0;
+    CHECK_VK(vkGetPipelineCacheData(context.device.v_logical, context.v_pipeline_cache, &size, VK_NULL_HANDLE));
+    std::vector<char> data(size);
+    if (size == 0 || vkGetPipelineCacheData(context.device.v_logical, context.v_pipeline_cache, &size, data.data()) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(context.device.v_physical, &properties);
+    const pipeline_cache_header header = make_header(properties, data.data(), size);
+
+    const std::string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    const bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data.data(), 1, size, file) == size;
+    if (fclose(file) != 0 || !written)
+    {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    // Replaces the old cache in one step, so a reader only ever sees a whole file.
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error)
+    {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void poly::vk::destroy_pipeline_cache(context& context)
+{
+    vkDestroyPipelineCache(context.device.v_logical, context.v_pipeline_cache, VK_NULL_HANDLE);
+    context.v_pipeline_cache = VK_NULL_HANDLE;
+}
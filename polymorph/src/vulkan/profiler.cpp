@@ -0,0 +1,298 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+using namespace poly::vk;
+
+constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+                                                            | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+                                                            | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+                                                            | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+                                                            | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+// Chrome trace argument names, in the order the statistics are written.
+static const char* const STATISTIC_NAMES[GPU_PIPELINE_STATISTIC_COUNT] =
+{
+    "input_assembly_vertices",
+    "vertex_shader_invocations",
+    "clipping_primitives",
+    "fragment_shader_invocations",
+    "compute_shader_invocations",
+};
+
+// ------------------------- UTILS -------------------------
+
+// Converts a reading of the host time domain to nanoseconds on the clock std::chrono::steady_clock reads.
+static int64_t host_ticks_to_ns(uint64_t ticks)
+{
+#ifdef _WIN32
+    static const int64_t frequency = []() { LARGE_INTEGER f; QueryPerformanceFrequency(&f); return static_cast<int64_t>(f.QuadPart); }();
+    return static_cast<int64_t>(ticks / frequency) * 1000000000 + static_cast<int64_t>(ticks % frequency) * 1000000000 / frequency;
+#else
+    return static_cast<int64_t>(ticks); // CLOCK_MONOTONIC is already in nanoseconds.
+#endif
+}
+
+static void calibrate(const context& context, gpu_profiler& profiler)
+{
+    VkCalibratedTimestampInfoEXT infos[2] = { { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT }, { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT } };
+    infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    infos[1].timeDomain = context.device.host_time_domain;
+
+    uint64_t timestamps[2] = {};
+    uint64_t deviation = 0;
+    CHECK_VK(context.device.get_calibrated_timestamps(context.device.v_logical, 2, infos, timestamps, &deviation));
+    profiler.gpu_to_cpu_ns = host_ticks_to_ns(timestamps[1]) - static_cast<int64_t>(static_cast<double>(timestamps[0] & profiler.tick_mask) * profiler.ns_per_tick);
+}
+
+// Reads the queries of the frame last recorded into this frame in flight, without waiting for them.
+static void resolve_frame(const context& context, gpu_profiler& profiler, gpu_profiler_frame& frame)
+{
+    const uint32_t count = static_cast<uint32_t>(frame.scopes.size());
+    if (frame.frame_number == 0 || count == 0)
+    {
+        return;
+    }
+    ASSERT_VK(frame.open.empty()); // Every scope of the frame must have been ended.
+
+    uint64_t* ticks = profiler.query_scratch.data();
+    if (vkGetQueryPoolResults(context.device.v_logical, frame.v_timestamps, 0, count * 2, sizeof(uint64_t) * count * 2, ticks,
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+    {
+        return;
+    }
+
+    uint64_t* statistics = ticks + profiler.max_scopes * 2;
+    if (frame.statistics_count > 0
+        && vkGetQueryPoolResults(context.device.v_logical, frame.v_statistics, 0, frame.statistics_count, sizeof(uint64_t) * GPU_PIPELINE_STATISTIC_COUNT * frame.statistics_count,
+                                 statistics, sizeof(uint64_t) * GPU_PIPELINE_STATISTIC_COUNT, VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+    {
+        return;
+    }
+
+    if (profiler.calibrated)
+    {
+        calibrate(context, profiler);
+    }
+
+    profiler.results.clear();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const gpu_scope& scope = frame.scopes[i];
+        const uint64_t start = ticks[i * 2] & profiler.tick_mask;
+        const uint64_t end = ticks[i * 2 + 1] & profiler.tick_mask;
+
+        gpu_scope_result& result = profiler.results.emplace_back();
+        result = {};
+        result.name = scope.name;
+        result.depth = scope.depth;
+        result.frame_number = frame.frame_number;
+        result.start_ns = static_cast<int64_t>(static_cast<double>(start) * profiler.ns_per_tick) + profiler.gpu_to_cpu_ns;
+        result.duration_ns = static_cast<int64_t>(static_cast<double>((end - start) & profiler.tick_mask) * profiler.ns_per_tick);
+        if (scope.statistics_query != UINT32_MAX)
+        {
+            memcpy(result.statistics, statistics + scope.statistics_query * GPU_PIPELINE_STATISTIC_COUNT, sizeof(result.statistics));
+        }
+    }
+
+    if (profiler.capturing)
+    {
+        profiler.trace.insert(profiler.trace.end(), profiler.results.begin(), profiler.results.end());
+    }
+}
+
+// ------------------------- GPU PROFILER -------------------------
+
+void poly::vk::create_gpu_profiler(const context& context, gpu_profiler& profiler, uint32_t frame_count, uint32_t max_scopes, bool pipeline_statistics)
+{
+    profiler.frames.resize(frame_count);
+    profiler.frame = 0;
+    profiler.max_scopes = max_scopes;
+    profiler.statistics = pipeline_statistics && context.device.supports_pipeline_statistics;
+
+    const uint32_t valid_bits = context.device.timestamp_valid_bits;
+    profiler.ns_per_tick = context.device.timestamp_period;
+    profiler.tick_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+    profiler.gpu_to_cpu_ns = 0;
+    profiler.calibrated = context.device.get_calibrated_timestamps != nullptr;
+
+    profiler.results.reserve(max_scopes);
+    profiler.query_scratch.resize(static_cast<size_t>(max_scopes) * (2 + GPU_PIPELINE_STATISTIC_COUNT));
+    profiler.capturing = false;
+
+    for (auto& frame : profiler.frames)
+    {
+        frame = {};
+        frame.scopes.reserve(max_scopes);
+        frame.open.reserve(max_scopes);
+        if (valid_bits == 0)
+        {
+            continue; // The graphics queue cannot write timestamps, so every scope is dropped.
+        }
+
+        VkQueryPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        pool_info.queryCount = max_scopes * 2;
+        CHECK_VK(vkCreateQueryPool(context.device.v_logical, &pool_info, VK_NULL_HANDLE, &frame.v_timestamps));
+
+        if (profiler.statistics)
+        {
+            pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            pool_info.queryCount = max_scopes;
+            pool_info.pipelineStatistics = PIPELINE_STATISTICS;
+            CHECK_VK(vkCreateQueryPool(context.device.v_logical, &pool_info, VK_NULL_HANDLE, &frame.v_statistics));
+        }
+    }
+}
+
+void poly::vk::destroy_gpu_profiler(const context& context, gpu_profiler& profiler)
+{
+    for (auto& frame : profiler.frames)
+    {
+        vkDestroyQueryPool(context.device.v_logical, frame.v_timestamps, VK_NULL_HANDLE);
+        vkDestroyQueryPool(context.device.v_logical, frame.v_statistics, VK_NULL_HANDLE);
+    }
+    profiler.frames.clear();
+    profiler.results.clear();
+    profiler.trace.clear();
+}
+
+void poly::vk::begin_gpu_profiler_frame(const context& context, gpu_profiler& profiler, const command_buffer& command_buffer, uint32_t frame, uint64_t frame_number)
+{
+    profiler.frame = frame % static_cast<uint32_t>(profiler.frames.size());
+    gpu_profiler_frame& current = profiler.frames[profiler.frame];
+    resolve_frame(context, profiler, current);
+
+    current.scopes.clear();
+    current.open.clear();
+    current.statistics_count = 0;
+    current.frame_number = frame_number;
+
+    if (current.v_timestamps != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(command_buffer.buf, current.v_timestamps, 0, profiler.max_scopes * 2);
+    }
+    if (current.v_statistics != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(command_buffer.buf, current.v_statistics, 0, profiler.max_scopes);
+    }
+}
+
+void poly::vk::begin_gpu_scope(gpu_profiler& profiler, const command_buffer& command_buffer, const char* name)
+{
+    gpu_profiler_frame& current = profiler.frames[profiler.frame];
+    if (current.v_timestamps == VK_NULL_HANDLE || current.scopes.size() >= profiler.max_scopes)
+    {
+        current.open.push_back(UINT32_MAX); // Still opened, so the matching end has a scope to close.
+        return;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(current.scopes.size());
+    gpu_scope scope{ name, static_cast<uint32_t>(current.open.size()), UINT32_MAX };
+    if (current.v_statistics != VK_NULL_HANDLE && current.open.empty())
+    {
+        scope.statistics_query = current.statistics_count++;
+        vkCmdBeginQuery(command_buffer.buf, current.v_statistics, scope.statistics_query, 0);
+    }
+    vkCmdWriteTimestamp(command_buffer.buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current.v_timestamps, index * 2);
+
+    current.scopes.push_back(scope);
+    current.open.push_back(index);
+}
+
+void poly::vk::end_gpu_scope(gpu_profiler& profiler, const command_buffer& command_buffer)
+{
+    gpu_profiler_frame& current = profiler.frames[profiler.frame];
+    ASSERT_VK(!current.open.empty());
+
+    const uint32_t index = current.open.back();
+    current.open.pop_back();
+    if (index == UINT32_MAX)
+    {
+        return;
+    }
+
+    vkCmdWriteTimestamp(command_buffer.buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current.v_timestamps, index * 2 + 1);
+    if (current.scopes[index].statistics_query != UINT32_MAX)
+    {
+        vkCmdEndQuery(command_buffer.buf, current.v_statistics, current.scopes[index].statistics_query);
+    }
+}
+
+double poly::vk::get_gpu_scope_ms(const gpu_profiler& profiler, const char* name)
+{
+    int64_t total_ns = 0;
+    for (const auto& result : profiler.results)
+    {
+        if (strcmp(result.name, name) == 0)
+        {
+            total_ns += result.duration_ns;
+        }
+    }
+    return static_cast<double>(total_ns) * 1e-6;
+}
+
+double poly::vk::get_gpu_frame_ms(const gpu_profiler& profiler)
+{
+    int64_t first = INT64_MAX;
+    int64_t last = INT64_MIN;
+    for (const auto& result : profiler.results)
+    {
+        if (result.depth == 0)
+        {
+            first = std::min(first, result.start_ns);
+            last = std::max(last, result.start_ns + result.duration_ns);
+        }
+    }
+    return first < last ? static_cast<double>(last - first) * 1e-6 : 0.0;
+}
+
+void poly::vk::capture_gpu_trace(gpu_profiler& profiler, bool capture)
+{
+    if (capture && !profiler.capturing)
+    {
+        profiler.trace.clear();
+    }
+    profiler.capturing = capture;
+}
+
+bool poly::vk::write_gpu_trace(const gpu_profiler& profiler, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    // Complete events on their own process, followed by the CPU zones, which share the clock once calibrated.
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"graphics queue\"}}");
+    for (const auto& event : profiler.trace)
+    {
+        fprintf(file, ",\n{\"name\":");
+        poly::write_json_string(file, event.name);
+        fprintf(file, ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu",
+                static_cast<double>(event.start_ns) * 1e-3, static_cast<double>(event.duration_ns) * 1e-3, static_cast<unsigned long long>(event.frame_number));
+        if (profiler.statistics && event.depth == 0)
+        {
+            for (uint32_t i = 0; i < GPU_PIPELINE_STATISTIC_COUNT; i++)
+            {
+                fprintf(file, ",\"%s\":%llu", STATISTIC_NAMES[i], static_cast<unsigned long long>(event.statistics[i]));
+            }
+        }
+        fprintf(file, "}}");
+    }
+    poly::write_trace_events(file);
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
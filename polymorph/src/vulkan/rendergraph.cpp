@@ -0,0 +1,490 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+
+using namespace poly::vk;
+
+constexpr uint32_t GRAPH_NONE = UINT32_MAX;
+
+constexpr VkPipelineStageFlags2 ALL_SHADER_STAGES = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+constexpr VkPipelineStageFlags2 DEPTH_TEST_STAGES = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+// ------------------------- UTILS -------------------------
+
+struct access_info
+{
+    VkImageLayout         layout; // VK_IMAGE_LAYOUT_UNDEFINED for accesses only buffers can have.
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2        access;
+    bool                  reads;
+    bool                  writes;
+};
+
+// Indexed by graph_access.
+static const access_info ACCESS_INFO[] =
+{
+    { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,         VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,             VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,                 true,  true  },
+    { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DEPTH_TEST_STAGES,                                           VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true,  true  },
+    { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,  DEPTH_TEST_STAGES | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT,                    true,  false },
+    { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,         ALL_SHADER_STAGES,                                           VK_ACCESS_2_SHADER_READ_BIT,                                                                    true,  false },
+    { VK_IMAGE_LAYOUT_GENERAL,                          ALL_SHADER_STAGES,                                           VK_ACCESS_2_SHADER_READ_BIT,                                                                    true,  false },
+    { VK_IMAGE_LAYOUT_GENERAL,                          ALL_SHADER_STAGES,                                           VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,                                     true,  true  },
+    { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,             VK_PIPELINE_STAGE_2_TRANSFER_BIT,                            VK_ACCESS_2_TRANSFER_READ_BIT,                                                                  true,  false },
+    { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,             VK_PIPELINE_STAGE_2_TRANSFER_BIT,                            VK_ACCESS_2_TRANSFER_WRITE_BIT,                                                                 false, true  },
+    { VK_IMAGE_LAYOUT_UNDEFINED,                        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,                       VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,                                                          true,  false },
+    { VK_IMAGE_LAYOUT_UNDEFINED,                        VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,                        VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT,                             true,  false },
+    { VK_IMAGE_LAYOUT_UNDEFINED,                        ALL_SHADER_STAGES,                                           VK_ACCESS_2_UNIFORM_READ_BIT,                                                                   true,  false },
+};
+static_assert(sizeof(ACCESS_INFO) / sizeof(ACCESS_INFO[0]) == static_cast<size_t>(graph_access::count), "every graph access needs its info");
+
+static bool is_transient(const graph_resource_entry& entry)
+{
+    return entry.img == nullptr && entry.buf == nullptr;
+}
+
+// Uses are stored contiguously in pass order, so the pass is the last one starting at or before the use.
+static uint32_t pass_of_use(const render_graph& graph, uint32_t use)
+{
+    auto it = std::upper_bound(graph.passes.begin(), graph.passes.end(), use, [](uint32_t u, const graph_pass& pass) { return u < pass.first_use; });
+    return static_cast<uint32_t>(it - graph.passes.begin() - 1);
+}
+
+// Walks back from the resources kept after the frame, keeping only passes which write something a kept pass reads.
+static void cull_passes(render_graph& graph)
+{
+    graph.needed.assign(graph.resources.size(), 0);
+    for (size_t r = 0; r < graph.resources.size(); r++)
+    {
+        graph.needed[r] = is_transient(graph.resources[r]) ? 0 : 1;
+    }
+
+    for (size_t p = graph.passes.size(); p-- > 0; )
+    {
+        graph_pass& pass = graph.passes[p];
+        pass.live = pass.side_effect;
+        for (uint32_t u = pass.first_use; u < pass.first_use + pass.use_count && !pass.live; u++)
+        {
+            pass.live = ACCESS_INFO[static_cast<size_t>(graph.uses[u].access)].writes && graph.needed[graph.uses[u].resource];
+        }
+        if (!pass.live)
+        {
+            continue;
+        }
+
+        for (uint32_t u = pass.first_use; u < pass.first_use + pass.use_count; u++)
+        {
+            const access_info& info = ACCESS_INFO[static_cast<size_t>(graph.uses[u].access)];
+            if (info.writes && !info.reads)
+            {
+                graph.needed[graph.uses[u].resource] = 0; // Overwritten, so earlier writes are not seen through this pass.
+            }
+        }
+        for (uint32_t u = pass.first_use; u < pass.first_use + pass.use_count; u++)
+        {
+            if (ACCESS_INFO[static_cast<size_t>(graph.uses[u].access)].reads)
+            {
+                graph.needed[graph.uses[u].resource] = 1;
+            }
+        }
+    }
+}
+
+// Read after write, write after write and write after read, following declaration order.
+static void build_edges(render_graph& graph)
+{
+    graph.edges.clear();
+    graph.last_writer.assign(graph.resources.size(), GRAPH_NONE);
+    graph.read_head.assign(graph.resources.size(), GRAPH_NONE);
+    graph.next_read.assign(graph.uses.size(), GRAPH_NONE);
+
+    for (uint32_t p = 0; p < graph.passes.size(); p++)
+    {
+        const graph_pass& pass = graph.passes[p];
+        if (!pass.live)
+        {
+            continue;
+        }
+
+        for (uint32_t u = pass.first_use; u < pass.first_use + pass.use_count; u++)
+        {
+            const graph_resource r = graph.uses[u].resource;
+            const access_info& info = ACCESS_INFO[static_cast<size_t>(graph.uses[u].access)];
+
+            if (graph.last_writer[r] != GRAPH_NONE)
+            {
+                graph.edges.push_back(graph.last_writer[r]);
+                graph.edges.push_back(p);
+            }
+
+            if (info.writes)
+            {
+                for (uint32_t read = graph.read_head[r]; read != GRAPH_NONE; read = graph.next_read[read])
+                {
+                    graph.edges.push_back(pass_of_use(graph, read));
+                    graph.edges.push_back(p);
+                }
+                graph.last_writer[r] = p;
+                graph.read_head[r] = GRAPH_NONE;
+            }
+            else
+            {
+                graph.next_read[u] = graph.read_head[r];
+                graph.read_head[r] = u;
+            }
+        }
+    }
+
+    // Groups the consumers of each pass, counting them first then placing each at the cursor of its producer.
+    graph.successor_start.assign(graph.passes.size() + 1, 0);
+    for (size_t i = 0; i < graph.edges.size(); i += 2)
+    {
+        graph.successor_start[graph.edges[i] + 1]++;
+    }
+    for (size_t p = 1; p < graph.successor_start.size(); p++)
+    {
+        graph.successor_start[p] += graph.successor_start[p - 1];
+    }
+    graph.successors.resize(graph.edges.size() / 2);
+    for (size_t i = 0; i < graph.edges.size(); i += 2)
+    {
+        graph.successors[graph.successor_start[graph.edges[i]]++] = graph.edges[i + 1];
+    }
+    for (size_t p = graph.passes.size(); p > 0; p--)
+    {
+        graph.successor_start[p] = graph.successor_start[p - 1]; // Each cursor stopped at the start of the next pass.
+    }
+    graph.successor_start[0] = 0;
+}
+
+// Kahn's algorithm, preferring a ready pass which does not depend on the one just scheduled, so dependent passes are spread apart.
+static void schedule_passes(render_graph& graph)
+{
+    graph.order.clear();
+    graph.in_degree.assign(graph.passes.size(), 0);
+    graph.follows.assign(graph.passes.size(), GRAPH_NONE);
+    for (size_t i = 0; i < graph.edges.size(); i += 2)
+    {
+        graph.in_degree[graph.edges[i + 1]]++;
+    }
+
+    uint32_t live_count = 0;
+    for (const auto& pass : graph.passes)
+    {
+        live_count += pass.live ? 1 : 0;
+    }
+
+    uint32_t previous = GRAPH_NONE;
+    while (graph.order.size() < live_count)
+    {
+        uint32_t chosen = GRAPH_NONE;
+        for (uint32_t p = 0; p < graph.passes.size(); p++)
+        {
+            if (!graph.passes[p].live || graph.in_degree[p] != 0)
+            {
+                continue;
+            }
+            if (chosen == GRAPH_NONE)
+            {
+                chosen = p;
+            }
+            if (previous == GRAPH_NONE || graph.follows[p] != previous)
+            {
+                chosen = p;
+                break;
+            }
+        }
+        ASSERT_VK(chosen != GRAPH_NONE); // Edges only ever point forward, so there is always a ready pass.
+
+        graph.in_degree[chosen] = GRAPH_NONE;
+        for (uint32_t s = graph.successor_start[chosen]; s < graph.successor_start[chosen + 1]; s++)
+        {
+            graph.in_degree[graph.successors[s]]--;
+            graph.follows[graph.successors[s]] = chosen;
+        }
+        graph.order.push_back(chosen);
+        previous = chosen;
+    }
+}
+
+static void assign_lifetimes(const context& context, render_graph& graph)
+{
+    for (auto& entry : graph.resources)
+    {
+        entry.first_use = GRAPH_NONE;
+        entry.last_use = GRAPH_NONE;
+    }
+    for (uint32_t i = 0; i < graph.order.size(); i++)
+    {
+        const graph_pass& pass = graph.passes[graph.order[i]];
+        for (uint32_t u = pass.first_use; u < pass.first_use + pass.use_count; u++)
+        {
+            graph_resource_entry& entry = graph.resources[graph.uses[u].resource];
+            entry.first_use = std::min(entry.first_use, i);
+            entry.last_use = i;
+        }
+    }
+
+    for (auto& entry : graph.resources)
+    {
+        if (is_transient(entry) && entry.first_use != GRAPH_NONE)
+        {
+            entry.target = request_render_target(*graph.targets, entry.desc, entry.first_use, entry.last_use);
+        }
+    }
+    resolve_render_targets(context, *graph.targets);
+}
+
+static void add_barrier(render_graph& graph, const graph_resource_entry& entry, VkImageLayout old_layout, VkImageLayout new_layout,
+                        VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access)
+{
+    if (entry.buf != nullptr)
+    {
+        VkBufferMemoryBarrier2& barrier = graph.buffer_barriers.emplace_back();
+        barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2 };
+        barrier.srcStageMask = src_stages;
+        barrier.srcAccessMask = src_access;
+        barrier.dstStageMask = dst_stages;
+        barrier.dstAccessMask = dst_access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = entry.buf->value;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        return;
+    }
+
+    const image& img = entry.img != nullptr ? *entry.img : get_render_target(*graph.targets, entry.target);
+
+    VkImageMemoryBarrier2& barrier = graph.image_barriers.emplace_back();
+    barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    barrier.srcStageMask = src_stages;
+    barrier.srcAccessMask = src_access;
+    barrier.dstStageMask = dst_stages;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = img.v_image;
+    barrier.subresourceRange.aspectMask = entry.aspect;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+}
+
+static void compute_barriers(render_graph& graph)
+{
+    graph.image_barriers.clear();
+    graph.buffer_barriers.clear();
+
+    for (auto& entry : graph.resources)
+    {
+        if (entry.img != nullptr)
+        {
+            entry.state = entry.img->state;
+        }
+        else if (entry.buf != nullptr)
+        {
+            entry.state = entry.buf->state;
+        }
+        else
+        {
+            entry.state = {};
+        }
+    }
+
+    // Transients alias the memory of those retired before them, so their first use waits for the last uses of those.
+    VkPipelineStageFlags2 retired_stages = 0;
+    VkAccessFlags2 retired_access = 0;
+
+    for (uint32_t i = 0; i < graph.order.size(); i++)
+    {
+        graph_pass& pass = graph.passes[graph.order[i]];
+        pass.first_image_barrier = static_cast<uint32_t>(graph.image_barriers.size());
+        pass.first_buffer_barrier = static_cast<uint32_t>(graph.buffer_barriers.size());
+
+        for (uint32_t u = pass.first_use; u < pass.first_use + pass.use_count; u++)
+        {
+            const graph_use& use = graph.uses[u];
+            const access_info& info = ACCESS_INFO[static_cast<size_t>(use.access)];
+            graph_resource_entry& entry = graph.resources[use.resource];
+
+            const bool is_image = entry.buf == nullptr;
+            ASSERT_VK(!is_image || info.layout != VK_IMAGE_LAYOUT_UNDEFINED);
+
+            resource_access next{};
+            next.layout = is_image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+            next.stages = use.stages != 0 ? use.stages : info.stages;
+            next.access = info.access;
+
+            if (is_transient(entry) && i == entry.first_use)
+            {
+                // Whatever the memory held before is discarded.
+                entry.state = { VK_IMAGE_LAYOUT_UNDEFINED, retired_stages, retired_access, 0, 0 };
+            }
+
+            VkPipelineStageFlags2 src_stages = 0;
+            VkAccessFlags2 src_access = 0;
+            VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (advance_resource_state(entry.state, next, false, src_stages, src_access, old_layout))
+            {
+                add_barrier(graph, entry, old_layout, next.layout, src_stages, src_access, next.stages, next.access);
+            }
+
+            if (is_transient(entry) && i == entry.last_use)
+            {
+                retired_stages |= entry.state.write_stages | entry.state.read_stages;
+                retired_access |= entry.state.write_access;
+            }
+        }
+
+        pass.image_barrier_count = static_cast<uint32_t>(graph.image_barriers.size()) - pass.first_image_barrier;
+        pass.buffer_barrier_count = static_cast<uint32_t>(graph.buffer_barriers.size()) - pass.first_buffer_barrier;
+    }
+
+    graph_pass& final_pass = graph.final_transitions;
+    final_pass = {};
+    final_pass.first_image_barrier = static_cast<uint32_t>(graph.image_barriers.size());
+    final_pass.first_buffer_barrier = static_cast<uint32_t>(graph.buffer_barriers.size());
+    for (auto& entry : graph.resources)
+    {
+        if (entry.img != nullptr && entry.final_layout != VK_IMAGE_LAYOUT_UNDEFINED && entry.final_layout != entry.state.layout)
+        {
+            // Only known to happen somewhere before later work, which waits through semaphores or its own barriers.
+            add_barrier(graph, entry, entry.state.layout, entry.final_layout, entry.state.write_stages | entry.state.read_stages, entry.state.write_access,
+                        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0);
+            entry.state = { entry.final_layout, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0, 0, 0 };
+        }
+    }
+    final_pass.image_barrier_count = static_cast<uint32_t>(graph.image_barriers.size()) - final_pass.first_image_barrier;
+
+    // The graph is recorded in the order it was compiled, so later barriers start from where this frame leaves each resource.
+    for (auto& entry : graph.resources)
+    {
+        if (entry.img != nullptr)
+        {
+            entry.img->state = entry.state;
+        }
+        else if (entry.buf != nullptr)
+        {
+            entry.buf->state = entry.state;
+        }
+    }
+}
+
+static void record_pass_barriers(const context& context, const command_buffer& command_buffer, const render_graph& graph, const graph_pass& pass)
+{
+    record_barriers(context, command_buffer, graph.image_barriers.data() + pass.first_image_barrier, pass.image_barrier_count,
+                    graph.buffer_barriers.data() + pass.first_buffer_barrier, pass.buffer_barrier_count);
+}
+
+// ------------------------- RENDER GRAPH -------------------------
+
+void poly::vk::begin_render_graph(render_graph& graph, render_target_pool& targets, uint32_t frame)
+{
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.uses.clear();
+    graph.order.clear();
+    graph.image_barriers.clear();
+    graph.buffer_barriers.clear();
+    graph.final_transitions = {};
+    graph.targets = &targets;
+    begin_render_targets(targets, frame);
+}
+
+graph_resource poly::vk::import_graph_image(render_graph& graph, image& img, VkImageLayout final_layout)
+{
+    graph_resource_entry entry{};
+    entry.img = &img;
+    entry.target = GRAPH_NONE;
+    entry.final_layout = final_layout;
+    entry.aspect = get_format_aspect(img.format);
+    graph.resources.push_back(entry);
+    return static_cast<graph_resource>(graph.resources.size() - 1);
+}
+
+graph_resource poly::vk::import_graph_buffer(render_graph& graph, buffer& buf)
+{
+    graph_resource_entry entry{};
+    entry.buf = &buf;
+    entry.target = GRAPH_NONE;
+    graph.resources.push_back(entry);
+    return static_cast<graph_resource>(graph.resources.size() - 1);
+}
+
+graph_resource poly::vk::create_graph_image(render_graph& graph, const render_target_desc& desc)
+{
+    graph_resource_entry entry{};
+    entry.desc = desc;
+    entry.target = GRAPH_NONE;
+    entry.final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    entry.aspect = get_format_aspect(desc.format);
+    graph.resources.push_back(entry);
+    return static_cast<graph_resource>(graph.resources.size() - 1);
+}
+
+uint32_t poly::vk::add_graph_pass(render_graph& graph, const char* name, graph_execute execute, void* data, bool side_effect)
+{
+    graph_pass pass{};
+    pass.name = name;
+    pass.execute = execute;
+    pass.data = data;
+    pass.first_use = static_cast<uint32_t>(graph.uses.size());
+    pass.use_count = 0;
+    pass.side_effect = side_effect;
+    graph.passes.push_back(pass);
+    return static_cast<uint32_t>(graph.passes.size() - 1);
+}
+
+void poly::vk::use_graph_resource(render_graph& graph, graph_resource resource, graph_access access, VkPipelineStageFlags2 stages)
+{
+    ASSERT_VK(!graph.passes.empty() && resource < graph.resources.size());
+
+    graph_pass& pass = graph.passes.back();
+    for (uint32_t u = pass.first_use; u < pass.first_use + pass.use_count; u++)
+    {
+        ASSERT_VK(graph.uses[u].resource != resource);
+    }
+
+    graph.uses.push_back(graph_use{ resource, access, stages });
+    pass.use_count++;
+}
+
+void poly::vk::compile_render_graph(const context& context, render_graph& graph)
+{
+    cull_passes(graph);
+    build_edges(graph);
+    schedule_passes(graph);
+    assign_lifetimes(context, graph);
+    compute_barriers(graph);
+}
+
+void poly::vk::execute_render_graph(const context& context, const command_buffer& command_buffer, const render_graph& graph)
+{
+    for (uint32_t index : graph.order)
+    {
+        const graph_pass& pass = graph.passes[index];
+        record_pass_barriers(context, command_buffer, graph, pass);
+        pass.execute(command_buffer, graph, pass.data);
+    }
+    record_pass_barriers(context, command_buffer, graph, graph.final_transitions);
+}
+
+const image& poly::vk::get_graph_image(const render_graph& graph, graph_resource resource)
+{
+    const graph_resource_entry& entry = graph.resources[resource];
+    if (entry.img != nullptr)
+    {
+        return *entry.img;
+    }
+    ASSERT_VK(entry.target != GRAPH_NONE); // Transients only exist while some live pass uses them.
+    return get_render_target(*graph.targets, entry.target);
+}
+
+const buffer& poly::vk::get_graph_buffer(const render_graph& graph, graph_resource resource)
+{
+    ASSERT_VK(graph.resources[resource].buf != nullptr);
+    return *graph.resources[resource].buf;
+}
@@ -0,0 +1,229 @@
+#include "polymorph/vulkan/context.h"
+
+#include <cstring>
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+// The state last recorded into the command buffer, so that matching packets skip their binds.
+struct bound_state
+{
+    const pipeline*    pipe = nullptr;
+    VkPipelineLayout   layout = VK_NULL_HANDLE;
+    VkDescriptorSet    sets[DRAW_PACKET_MAX_SETS] = {};
+    uint32_t           set_count = 0;
+    VkBuffer           vertex_buffer = VK_NULL_HANDLE;
+    VkDeviceSize       vertex_buffer_offset = 0;
+    VkBuffer           index_buffer = VK_NULL_HANDLE;
+    VkDeviceSize       index_buffer_offset = 0;
+    VkIndexType        index_type = VK_INDEX_TYPE_UINT16;
+    const uint8_t*     push_data = nullptr;
+    uint32_t           push_size = 0;
+    VkShaderStageFlags push_stages = 0;
+};
+
+// One least significant digit pass, 8 bits at a time, skipped when every key shares the digit.
+static void radix_pass(render_queue& queue, uint32_t shift)
+{
+    uint32_t counts[256] = {};
+    const size_t n = queue.keys.size();
+    for (size_t i = 0; i < n; i++)
+    {
+        counts[(queue.keys[i] >> shift) & 0xff]++;
+    }
+    if (counts[(queue.keys[0] >> shift) & 0xff] == n)
+    {
+        return;
+    }
+
+    uint32_t offset = 0;
+    for (uint32_t& count : counts)
+    {
+        uint32_t c = count;
+        count = offset;
+        offset += c;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t dst = counts[(queue.keys[i] >> shift) & 0xff]++;
+        queue.keys_scratch[dst] = queue.keys[i];
+        queue.order_scratch[dst] = queue.order[i];
+    }
+    queue.keys.swap(queue.keys_scratch);
+    queue.order.swap(queue.order_scratch);
+}
+
+// ------------------------- RENDER QUEUE -------------------------
+
+uint64_t poly::vk::make_sort_key(uint8_t layer, uint16_t pipeline_id, uint16_t material_id, uint32_t depth)
+{
+    return (static_cast<uint64_t>(layer) << 56)
+         | (static_cast<uint64_t>(pipeline_id) << 40)
+         | (static_cast<uint64_t>(material_id) << 24)
+         | (depth & 0xffffffu);
+}
+
+void poly::vk::submit_draw(render_queue& queue, const draw_packet& packet, const void* push_constants)
+{
+    ASSERT_VK(packet.pipe != nullptr && packet.set_count <= DRAW_PACKET_MAX_SETS);
+
+    draw_packet& added = queue.packets.emplace_back(packet);
+    added.push_data = static_cast<uint32_t>(queue.push_data.size());
+    if (packet.push_size > 0)
+    {
+        ASSERT_VK(push_constants != nullptr);
+        const uint8_t* bytes = static_cast<const uint8_t*>(push_constants);
+        queue.push_data.insert(queue.push_data.end(), bytes, bytes + packet.push_size);
+    }
+}
+
+void poly::vk::sort_render_queue(render_queue& queue)
+{
+    const size_t n = queue.packets.size();
+
+    // Only keys and indices move, the packets stay where they were submitted.
+    queue.keys.resize(n);
+    queue.keys_scratch.resize(n);
+    queue.order.resize(n);
+    queue.order_scratch.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        queue.keys[i] = queue.packets[i].key;
+        queue.order[i] = static_cast<uint32_t>(i);
+    }
+
+    if (n < 2)
+    {
+        return;
+    }
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        radix_pass(queue, shift);
+    }
+}
+
+render_queue_stats poly::vk::record_render_queue(const command_buffer& command_buffer, const render_queue& queue, uint32_t first, uint32_t end)
+{
+    VkCommandBuffer cmd = command_buffer.buf;
+    render_queue_stats stats{};
+    bound_state bound;
+
+    for (uint32_t i = first; i < end; i++)
+    {
+        const draw_packet& packet = queue.packets[queue.order[i]];
+
+        if (packet.pipe != bound.pipe)
+        {
+            vkCmdBindPipeline(cmd, packet.pipe->v_bind_point, packet.pipe->v_pipeline);
+            stats.pipeline_binds++;
+            bound.pipe = packet.pipe;
+        }
+        else
+        {
+            stats.skipped++;
+        }
+
+        // Sets bound with another layout are not guaranteed compatible, so they are all bound again.
+        if (packet.pipe->v_layout != bound.layout)
+        {
+            bound.layout = packet.pipe->v_layout;
+            bound.set_count = 0;
+            bound.push_data = nullptr;
+        }
+
+        uint32_t first_set = 0;
+        while (first_set < packet.set_count && first_set < bound.set_count && packet.sets[first_set] == bound.sets[first_set])
+        {
+            first_set++;
+        }
+        if (first_set < packet.set_count)
+        {
+            vkCmdBindDescriptorSets(cmd, packet.pipe->v_bind_point, packet.pipe->v_layout, first_set, packet.set_count - first_set,
+                                    packet.sets + first_set, 0, nullptr);
+            stats.set_binds++;
+            memcpy(bound.sets + first_set, packet.sets + first_set, sizeof(VkDescriptorSet) * (packet.set_count - first_set));
+            bound.set_count = packet.set_count;
+        }
+        else if (packet.set_count > 0)
+        {
+            stats.skipped++;
+        }
+
+        if (packet.vertex_buffer != VK_NULL_HANDLE)
+        {
+            if (packet.vertex_buffer != bound.vertex_buffer || packet.vertex_buffer_offset != bound.vertex_buffer_offset)
+            {
+                vkCmdBindVertexBuffers(cmd, 0, 1, &packet.vertex_buffer, &packet.vertex_buffer_offset);
+                stats.buffer_binds++;
+                bound.vertex_buffer = packet.vertex_buffer;
+                bound.vertex_buffer_offset = packet.vertex_buffer_offset;
+            }
+            else
+            {
+                stats.skipped++;
+            }
+        }
+
+        if (packet.index_buffer != VK_NULL_HANDLE)
+        {
+            if (packet.index_buffer != bound.index_buffer || packet.index_buffer_offset != bound.index_buffer_offset || packet.index_type != bound.index_type)
+            {
+                vkCmdBindIndexBuffer(cmd, packet.index_buffer, packet.index_buffer_offset, packet.index_type);
+                stats.buffer_binds++;
+                bound.index_buffer = packet.index_buffer;
+                bound.index_buffer_offset = packet.index_buffer_offset;
+                bound.index_type = packet.index_type;
+            }
+            else
+            {
+                stats.skipped++;
+            }
+        }
+
+        if (packet.push_size > 0)
+        {
+            const uint8_t* data = queue.push_data.data() + packet.push_data;
+            if (bound.push_data == nullptr || packet.push_size != bound.push_size || packet.push_stages != bound.push_stages
+                || memcmp(data, bound.push_data, packet.push_size) != 0)
+            {
+                vkCmdPushConstants(cmd, packet.pipe->v_layout, packet.push_stages, 0, packet.push_size, data);
+                stats.push_constants++;
+                bound.push_data = data;
+                bound.push_size = packet.push_size;
+                bound.push_stages = packet.push_stages;
+            }
+            else
+            {
+                stats.skipped++;
+            }
+        }
+
+        if (packet.index_buffer != VK_NULL_HANDLE)
+        {
+            vkCmdDrawIndexed(cmd, packet.count, packet.instance_count, packet.first, packet.vertex_offset, packet.first_instance);
+        }
+        else
+        {
+            vkCmdDraw(cmd, packet.count, packet.instance_count, packet.first, packet.first_instance);
+        }
+        stats.draws++;
+    }
+    return stats;
+}
+
+render_queue_stats poly::vk::flush_render_queue(const command_buffer& command_buffer, render_queue& queue)
+{
+    sort_render_queue(queue);
+    render_queue_stats stats = record_render_queue(command_buffer, queue, 0, static_cast<uint32_t>(queue.packets.size()));
+    clear_render_queue(queue);
+    return stats;
+}
+
+void poly::vk::clear_render_queue(render_queue& queue)
+{
+    // Capacity is kept, so a steady frame submits without allocating.
+    queue.packets.clear();
+    queue.push_data.clear();
+}
@@ -0,0 +1,204 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+// Memory that several non-overlapping render targets are bound to.
+struct alias_slot
+{
+    VkMemoryRequirements  requirements;
+    bool                  lazy;
+    std::vector<uint32_t> targets;
+};
+
+static bool same_request(const render_target_request& a, const render_target_request& b)
+{
+    return a.desc.format == b.desc.format
+        && a.desc.extent.width == b.desc.extent.width
+        && a.desc.extent.height == b.desc.extent.height
+        && a.desc.usage == b.desc.usage
+        && a.desc.samples == b.desc.samples
+        && a.first_use == b.first_use
+        && a.last_use == b.last_use;
+}
+
+static bool overlaps(const render_target_request& a, const render_target_request& b)
+{
+    return a.first_use <= b.last_use && b.first_use <= a.last_use;
+}
+
+static void release_frame(const context& context, render_target_frame& frame)
+{
+    for (auto& img : frame.images)
+    {
+        if (img.v_view != VK_NULL_HANDLE) release_image_view(context, img.v_view);
+        vkDestroyImage(context.device.v_logical, img.v_image, VK_NULL_HANDLE);
+    }
+    for (auto allocation : frame.memory)
+    {
+        VmaAllocationInfo info{};
+        vmaGetAllocationInfo(context.allocator, allocation, &info);
+        track_free(context, memory_category::render_target, info.size);
+        vmaFreeMemory(context.allocator, allocation);
+    }
+    frame.images.clear();
+    frame.memory.clear();
+    frame.layout.clear();
+}
+
+// ------------------------- RENDER TARGET POOL -------------------------
+
+void poly::vk::create_render_target_pool(const context& context, render_target_pool& pool, uint32_t frame_count)
+{
+    pool.frames.resize(frame_count);
+    pool.frame = 0;
+
+    // Tile-based GPUs can keep transient attachments in on-chip memory without ever backing them.
+    const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+    vmaGetMemoryProperties(context.allocator, &properties);
+
+    pool.supports_lazy_memory = false;
+    for (uint32_t i = 0; i < properties->memoryTypeCount; i++)
+    {
+        if (properties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+        {
+            pool.supports_lazy_memory = true;
+        }
+    }
+}
+
+void poly::vk::destroy_render_target_pool(const context& context, render_target_pool& pool)
+{
+    for (auto& frame : pool.frames)
+    {
+        release_frame(context, frame);
+    }
+    pool.frames.clear();
+    pool.requests.clear();
+}
+
+void poly::vk::begin_render_targets(render_target_pool& pool, uint32_t frame)
+{
+    pool.frame = frame % static_cast<uint32_t>(pool.frames.size());
+    pool.requests.clear();
+}
+
+uint32_t poly::vk::request_render_target(render_target_pool& pool, const render_target_desc& desc, uint32_t first_use, uint32_t last_use)
+{
+    pool.requests.push_back(render_target_request{ desc, first_use, last_use });
+    return static_cast<uint32_t>(pool.requests.size() - 1);
+}
+
+void poly::vk::resolve_render_targets(const context& context, render_target_pool& pool)
+{
+    render_target_frame& frame = pool.frames[pool.frame];
+
+    if (frame.layout.size() == pool.requests.size() && std::equal(frame.layout.begin(), frame.layout.end(), pool.requests.begin(), same_request))
+    {
+        return;
+    }
+
+    // Only this frame used these, and its fence has been waited on.
+    release_frame(context, frame);
+    frame.layout = pool.requests;
+    frame.images.resize(pool.requests.size());
+
+    std::vector<VkMemoryRequirements> requirements(pool.requests.size());
+    for (size_t i = 0; i < pool.requests.size(); i++)
+    {
+        const render_target_desc& desc = pool.requests[i].desc;
+
+        VkImageCreateInfo info{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = desc.format;
+        info.extent = { desc.extent.width, desc.extent.height, 1 };
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = desc.samples;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = desc.usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        image& img = frame.images[i];
+        img = {};
+        CHECK_VK(vkCreateImage(context.device.v_logical, &info, VK_NULL_HANDLE, &img.v_image));
+        vkGetImageMemoryRequirements(context.device.v_logical, img.v_image, &requirements[i]);
+
+        img.format = desc.format;
+        img.extent = info.extent;
+        img.mip_levels = 1;
+        img.array_layers = 1;
+        img.category = memory_category::render_target;
+    }
+
+    // Largest first, each into the first slot whose targets are all used in other passes.
+    std::vector<uint32_t> order(pool.requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+    std::vector<alias_slot> slots;
+    for (uint32_t target : order)
+    {
+        const render_target_request& request = pool.requests[target];
+        const bool lazy = pool.supports_lazy_memory && (request.desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+
+        alias_slot* chosen = nullptr;
+        for (auto& slot : slots)
+        {
+            if (lazy || slot.lazy || (slot.requirements.memoryTypeBits & requirements[target].memoryTypeBits) == 0)
+            {
+                continue; // Lazily allocated memory is never backed, so there is nothing to gain from sharing it.
+            }
+            bool free = std::none_of(slot.targets.begin(), slot.targets.end(), [&](uint32_t other) { return overlaps(request, pool.requests[other]); });
+            if (free)
+            {
+                chosen = &slot;
+                break;
+            }
+        }
+
+        if (chosen == nullptr)
+        {
+            chosen = &slots.emplace_back();
+            chosen->requirements = requirements[target];
+            chosen->lazy = lazy;
+        }
+        else
+        {
+            chosen->requirements.size = std::max(chosen->requirements.size, requirements[target].size);
+            chosen->requirements.alignment = std::max(chosen->requirements.alignment, requirements[target].alignment);
+            chosen->requirements.memoryTypeBits &= requirements[target].memoryTypeBits;
+        }
+        chosen->targets.push_back(target);
+    }
+
+    frame.memory.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        VmaAllocationCreateInfo allocation_info{};
+        allocation_info.usage = slots[i].lazy ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED : VMA_MEMORY_USAGE_UNKNOWN;
+        allocation_info.requiredFlags = slots[i].lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+        VmaAllocationInfo result{};
+        CHECK_VK(vmaAllocateMemory(context.allocator, &slots[i].requirements, &allocation_info, &frame.memory[i], &result));
+        vmaSetAllocationName(context.allocator, frame.memory[i], slots[i].lazy ? "lazy render target" : "aliased render targets");
+        track_allocation(context, memory_category::render_target, result.size);
+
+        for (uint32_t target : slots[i].targets)
+        {
+            image& img = frame.images[target];
+            CHECK_VK(vmaBindImageMemory(context.allocator, frame.memory[i], img.v_image));
+            create_image_view(context, img, img.format, get_format_aspect(img.format));
+        }
+    }
+}
+
+const image& poly::vk::get_render_target(const render_target_pool& pool, uint32_t index)
+{
+    return pool.frames[pool.frame].images[index];
+}
@@ -0,0 +1,203 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace poly::vk;
+
+constexpr uint32_t TEXTURE_CONTAINER_VERSION = 1;
+
+// ------------------------- UTILS -------------------------
+
+static VkExtent3D level_extent(const streamed_texture& texture, uint32_t mip)
+{
+    return { std::max(1u, texture.extent.width >> mip), std::max(1u, texture.extent.height >> mip), 1 };
+}
+
+// The chain ends at a 1x1 level, and a longer one would repeat it.
+static uint32_t full_mip_count(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    for (uint32_t largest = std::max(width, height); largest > 1; largest >>= 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+// Checks everything the uploads of the levels rely on, so a bad file is rejected before any of it is read.
+static texture_container_header validate_container(const mapped_file& file)
+{
+    if (file.size < sizeof(texture_container_header))
+    {
+        THROW_VK("texture container is truncated");
+    }
+
+    texture_container_header header;
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, "PTEX", 4) != 0 || header.version != TEXTURE_CONTAINER_VERSION || header.width == 0 || header.height == 0
+        || header.mip_levels == 0 || header.mip_levels > full_mip_count(header.width, header.height) || header.array_layers == 0)
+    {
+        THROW_VK("texture container header is invalid");
+    }
+
+    const format_block block = get_format_block(header.format);
+    if (block.width != 1 || block.height != 1 || block.bytes == 0)
+    {
+        THROW_VK("texture container format is compressed or unsupported");
+    }
+
+    const size_t table_end = sizeof(header) + sizeof(texture_container_level) * header.mip_levels;
+    if (file.size < table_end)
+    {
+        THROW_VK("texture container level table is truncated");
+    }
+
+    const texture_container_level* levels = reinterpret_cast<const texture_container_level*>(file.data + sizeof(header));
+    for (uint32_t mip = 0; mip < header.mip_levels; mip++)
+    {
+        const texture_container_level& level = levels[mip];
+        if (level.offset < table_end || level.offset > file.size || level.size > file.size - level.offset)
+        {
+            THROW_VK("texture container level lies outside the file");
+        }
+
+        const uint64_t width = std::max(1u, header.width >> mip);
+        const uint64_t height = std::max(1u, header.height >> mip);
+        if (level.size != width * height * block.bytes * header.array_layers)
+        {
+            THROW_VK("texture container level size does not match its extent");
+        }
+    }
+    return header;
+}
+
+// Creates an image holding the levels from top_mip down, and queues each of them from the mapping.
+static upload_ticket stream_levels(context& context, streamed_texture& texture, image& img, uint32_t top_mip)
+{
+    VkExtent3D top = level_extent(texture, top_mip);
+
+    image_cfg cfg = image_cfg::texture(texture.format, top.width, top.height, texture.array_layers);
+    cfg.mip_levels = texture.mip_levels - top_mip;
+    cfg.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    create_image(context, img, cfg);
+    create_image_view(context, img, texture.format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    upload_ticket ticket{};
+    for (uint32_t mip = top_mip; mip < texture.mip_levels; mip++)
+    {
+        VkImageSubresourceLayers subresource{};
+        subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        subresource.mipLevel = mip - top_mip;
+        subresource.baseArrayLayer = 0;
+        subresource.layerCount = texture.array_layers;
+
+        const texture_container_level& level = texture.levels[mip];
+        ticket = enqueue_image_upload(context, context.uploads, img, subresource, level_extent(texture, mip), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      level.size, texture.file.data + level.offset);
+    }
+    return ticket;
+}
+
+// ------------------------- STREAMED TEXTURE -------------------------
+
+upload_ticket poly::vk::open_streamed_texture(context& context, streamed_texture& texture, const std::string& path, uint32_t tail_size)
+{
+    ASSERT_VK(texture.file.data == nullptr); // Still open, and clearing it would leak the mapping.
+    texture = {};
+    poly::map_file(texture.file, path);
+
+    texture_container_header header;
+    try
+    {
+        header = validate_container(texture.file);
+    }
+    catch (...)
+    {
+        poly::unmap_file(texture.file);
+        throw;
+    }
+
+    texture.levels = reinterpret_cast<const texture_container_level*>(texture.file.data + sizeof(header));
+    texture.format = header.format;
+    texture.extent = { header.width, header.height, 1 };
+    texture.mip_levels = header.mip_levels;
+    texture.array_layers = header.array_layers;
+
+    // The tail starts at the first level small enough, or the last level if none are.
+    texture.tail_mip = texture.mip_levels - 1;
+    for (uint32_t mip = 0; mip < texture.mip_levels; mip++)
+    {
+        VkExtent3D extent = level_extent(texture, mip);
+        if (std::max(extent.width, extent.height) <= tail_size)
+        {
+            texture.tail_mip = mip;
+            break;
+        }
+    }
+
+    texture.resident_mip = texture.tail_mip;
+    texture.requested_mip = texture.tail_mip;
+    texture.pending_active = false;
+    return stream_levels(context, texture, texture.img, texture.tail_mip);
+}
+
+void poly::vk::close_streamed_texture(context& context, streamed_texture& texture)
+{
+    defer_destroy_image(context, texture.img);
+    if (texture.pending_active)
+    {
+        // The deferral only covers frames in flight, not a transfer still writing the image.
+        wait_for_upload(context, context.uploads, texture.pending_ticket);
+        defer_destroy_image(context, texture.pending);
+        texture.pending_active = false;
+    }
+    poly::unmap_file(texture.file); // Staged copies were taken when the uploads were queued.
+    texture.levels = nullptr;
+}
+
+void poly::vk::request_texture_mip(streamed_texture& texture, uint32_t mip)
+{
+    texture.requested_mip = std::min(mip, texture.tail_mip);
+}
+
+bool poly::vk::update_streamed_texture(context& context, streamed_texture& texture, float max_pressure)
+{
+    if (texture.pending_active)
+    {
+        if (!is_upload_complete(context, context.uploads, texture.pending_ticket))
+        {
+            return false;
+        }
+
+        // Frames in flight may still sample the old image.
+        defer_destroy_image(context, texture.img);
+        texture.img = texture.pending;
+        texture.pending = {};
+        texture.resident_mip = texture.pending_mip;
+        texture.pending_active = false;
+        return true;
+    }
+
+    uint32_t target = texture.requested_mip;
+    if (get_memory_pressure(context.budget) > max_pressure)
+    {
+        // Drop one level at a time, never below the tail, and hold off streaming in.
+        target = std::min(texture.resident_mip + 1, texture.tail_mip);
+        if (target == texture.resident_mip)
+        {
+            return false;
+        }
+    }
+
+    if (target == texture.resident_mip)
+    {
+        return false;
+    }
+
+    texture.pending_mip = target;
+    texture.pending_ticket = stream_levels(context, texture, texture.pending, target);
+    texture.pending_active = true;
+    return false;
+}
@@ -9,6 +9,28 @@ using namespace poly::vk;
 
 // ------------------------- UTILS -------------------------
 
+struct present_policy_info
+{
+    VkPresentModeKHR modes[2];         // In order of preference, with FIFO, which is always supported, as the last resort.
+    uint32_t         extra_images;     // Requested beyond the minimum the surface needs.
+    uint32_t         frames_in_flight;
+};
+
+// Indexed by present_policy.
+static const present_policy_info POLICY_INFO[] =
+{
+    { { VK_PRESENT_MODE_MAILBOX_KHR,   VK_PRESENT_MODE_FIFO_KHR    }, 1, 1 },
+    { { VK_PRESENT_MODE_MAILBOX_KHR,   VK_PRESENT_MODE_FIFO_KHR    }, 1, UINT32_MAX },
+    { { VK_PRESENT_MODE_FIFO_KHR,      VK_PRESENT_MODE_FIFO_KHR    }, 1, 2 },
+    { { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR }, 0, 1 },
+};
+static_assert(sizeof(POLICY_INFO) / sizeof(POLICY_INFO[0]) == static_cast<size_t>(present_policy::count), "every present policy needs its info");
+
+static const present_policy_info& policy_info(const context& context)
+{
+    return POLICY_INFO[static_cast<size_t>(context.swapchain.policy)];
+}
+
 static VkSurfaceFormatKHR get_swap_surface_format(context& context, const std::vector<VkSurfaceFormatKHR>& formats)
 {
     for (const auto& available : formats) {
@@ -21,9 +43,9 @@ static VkSurfaceFormatKHR get_swap_surface_format(context& context, const std::v
 
 static VkPresentModeKHR get_swap_present_mode(context& context, const std::vector<VkPresentModeKHR>& modes)
 {
-    for (const auto& available : modes) {
-        if (available == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return available;
+    for (VkPresentModeKHR preferred : policy_info(context).modes) {
+        if (std::find(modes.begin(), modes.end(), preferred) != modes.end()) {
+            return preferred;
         }
     }
     return VK_PRESENT_MODE_FIFO_KHR;
@@ -60,7 +82,7 @@ void poly::vk::create_swapchain(context& context)
     auto present_mode = get_swap_present_mode(context, ssd.present_modes);
     auto extent = get_swap_extent(context, ssd.capabilities);
 
-    uint32_t image_count = ssd.capabilities.minImageCount + 1;
+    uint32_t image_count = ssd.capabilities.minImageCount + policy_info(context).extra_images;
     if (ssd.capabilities.maxImageCount > 0 && image_count > ssd.capabilities.maxImageCount)
     {
         image_count = ssd.capabilities.maxImageCount;
@@ -105,23 +127,43 @@ void poly::vk::create_swapchain(context& context)
     vkGetSwapchainImagesKHR(context.device.v_logical, context.swapchain.v_swapchain, &image_count, VK_NULL_HANDLE);
     context.swapchain.images.resize(image_count);
     vkGetSwapchainImagesKHR(context.device.v_logical, context.swapchain.v_swapchain, &image_count, context.swapchain.images.data());
+
+    VkSemaphoreCreateInfo semaphore_info { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    context.swapchain.semas_render_finished.resize(image_count);
+    for (auto& sema : context.swapchain.semas_render_finished)
+    {
+        CHECK_VK(vkCreateSemaphore(context.device.v_logical, &semaphore_info, VK_NULL_HANDLE, &sema));
+    }
+
+    context.swapchain.frames_in_flight = std::clamp(policy_info(context).frames_in_flight, 1u, context.swapchain.max_frames_in_flight);
 }
 
 void poly::vk::recreate_swapchain(context& context)
 {
+    POLY_TRACE_ZONE("recreate_swapchain");
     int width = 0, height = 0;
     glfwGetFramebufferSize(context.glfw_window, &width, &height);
 
-    while (width == 0 || height == 0)
     {
-        glfwGetFramebufferSize(context.glfw_window, &width, &height);
-        glfwWaitEvents();
+        POLY_TRACE_ZONE("wait for window");
+        while (width == 0 || height == 0)
+        {
+            glfwGetFramebufferSize(context.glfw_window, &width, &height);
+            glfwWaitEvents();
+        }
     }
 
-    vkDeviceWaitIdle(context.device.v_logical);
+    {
+        POLY_TRACE_ZONE("wait for device idle");
+        vkDeviceWaitIdle(context.device.v_logical);
+    }
 
-    destroy_swapchain(context);
+    {
+        POLY_TRACE_ZONE("destroy swapchain");
+        destroy_swapchain(context);
+    }
 
+    POLY_TRACE_ZONE("create swapchain");
     create_swapchain(context);
     create_swap_image_views(context);
     create_swap_framebuffers(context);
@@ -135,15 +177,37 @@ void poly::vk::destroy_swapchain(context& context)
     context.swapchain.framebuffers.clear();
 
     for (size_t i = 0; i < context.swapchain.image_views.size(); i++) {
-        vkDestroyImageView(context.device.v_logical, context.swapchain.image_views[i], nullptr);
+        release_image_view(context, context.swapchain.image_views[i]);
     }
     context.swapchain.image_views.clear();
     context.swapchain.images.clear();
 
+    for (auto sema : context.swapchain.semas_render_finished)
+    {
+        vkDestroySemaphore(context.device.v_logical, sema, VK_NULL_HANDLE);
+    }
+    context.swapchain.semas_render_finished.clear();
+
     vkDestroySwapchainKHR(context.device.v_logical, context.swapchain.v_swapchain, nullptr);
     context.swapchain.v_swapchain = VK_NULL_HANDLE;
 }
 
+void poly::vk::set_present_policy(context& context, draw_state_context& dsc, present_policy policy)
+{
+    context.swapchain.policy = policy;
+    recreate_swapchain(context); // Waits for the device to idle, so every frame in flight has finished.
+
+    // Frames in flight the new policy leaves unused would otherwise hold their deletions until used again.
+    for (uint32_t frame = 0; frame < context.swapchain.max_frames_in_flight; frame++)
+    {
+        flush_deletion_queue(context, context.deletions, frame);
+    }
+
+    dsc.current_frame = 0;
+    skip_frame_presents(dsc.sync.latency, dsc.sync.frame_number);
+    reset_frame_latency(dsc.sync.latency);
+}
+
 void poly::vk::create_swap_image_views(context& context)
 {
     context.swapchain.image_views.resize(context.swapchain.images.size());
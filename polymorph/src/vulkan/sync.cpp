@@ -2,25 +2,78 @@
 
 using namespace poly::vk;
 
+// ------------------------- QUEUE TIMELINE -------------------------
+
+void poly::vk::create_queue_timeline(const context& context, queue_timeline& timeline)
+{
+	VkSemaphoreTypeCreateInfo type_info{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_info.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphore_info{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+	semaphore_info.pNext = &type_info;
+	CHECK_VK(vkCreateSemaphore(context.device.v_logical, &semaphore_info, VK_NULL_HANDLE, &timeline.v_semaphore));
+	timeline.submitted = 0;
+}
+
+void poly::vk::destroy_queue_timeline(const context& context, queue_timeline& timeline)
+{
+	vkDestroySemaphore(context.device.v_logical, timeline.v_semaphore, VK_NULL_HANDLE);
+	timeline.v_semaphore = VK_NULL_HANDLE;
+	timeline.submitted = 0;
+}
+
+uint64_t poly::vk::next_timeline_value(queue_timeline& timeline, uint64_t value)
+{
+	ASSERT_VK(value == 0 || value > timeline.submitted);
+	timeline.submitted = value != 0 ? value : timeline.submitted + 1;
+	return timeline.submitted;
+}
+
+uint64_t poly::vk::get_timeline_value(const context& context, const queue_timeline& timeline)
+{
+	uint64_t value = 0;
+	CHECK_VK(vkGetSemaphoreCounterValue(context.device.v_logical, timeline.v_semaphore, &value));
+	return value;
+}
+
+bool poly::vk::wait_timeline(const context& context, const queue_timeline& timeline, uint64_t value, uint64_t timeout)
+{
+	ASSERT_VK(value <= timeline.submitted); // Nothing would ever signal it.
+
+	VkSemaphoreWaitInfo wait_info{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &timeline.v_semaphore;
+	wait_info.pValues = &value;
+
+	VkResult result = vkWaitSemaphores(context.device.v_logical, &wait_info, timeout);
+	if (result == VK_TIMEOUT)
+	{
+		return false;
+	}
+	CHECK_VK(result);
+	return true;
+}
+
+// ------------------------- SYNCHRON -------------------------
+
 void poly::vk::create_synchron(const context& context, synchron& syncs, uint32_t count)
 {
 	syncs.semas_image_available.resize(count);
-	syncs.semas_render_finished.resize(count);
-	syncs.fences_in_flight.resize(count);
+	syncs.frame_numbers.assign(count, 0);
+	syncs.frame_number = 1;
+	syncs.latency = {};
+	syncs.latency.gpu_pending = syncs.frame_number;
+	syncs.latency.present_pending = syncs.frame_number;
 
 	VkSemaphoreCreateInfo semaphore_info{};
 	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fence_info{};
-	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
 	for (size_t i = 0; i < count; i++)
 	{
 		CHECK_VK(vkCreateSemaphore(context.device.v_logical, &semaphore_info, nullptr, &syncs.semas_image_available[i]));
-		CHECK_VK(vkCreateSemaphore(context.device.v_logical, &semaphore_info, nullptr, &syncs.semas_render_finished[i]));
-		CHECK_VK(vkCreateFence(context.device.v_logical, &fence_info, nullptr, &syncs.fences_in_flight[i]));
 	}
+	create_queue_timeline(context, syncs.graphics);
 }
 
 void poly::vk::destroy_synchron(const context& context, synchron& sync)
@@ -30,14 +83,21 @@ void poly::vk::destroy_synchron(const context& context, synchron& sync)
 		vkDestroySemaphore(context.device.v_logical, sema, VK_NULL_HANDLE);
 	}
 	sync.semas_image_available.clear();
-	for (auto& sema : sync.semas_render_finished)
-	{
-		vkDestroySemaphore(context.device.v_logical, sema, VK_NULL_HANDLE);
-	}
-	sync.semas_render_finished.clear();
-	for (auto& fence : sync.fences_in_flight)
-	{
-		vkDestroyFence(context.device.v_logical, fence, VK_NULL_HANDLE);
-	}
-	sync.fences_in_flight.clear();
+	destroy_queue_timeline(context, sync.graphics);
+	sync.frame_numbers.clear();
+}
+
+uint64_t poly::vk::get_finished_frame(const context& context, const synchron& sync)
+{
+	return get_timeline_value(context, sync.graphics);
+}
+
+bool poly::vk::is_frame_finished(const context& context, const synchron& sync, uint64_t frame_number)
+{
+	return frame_number <= get_timeline_value(context, sync.graphics);
+}
+
+void poly::vk::wait_for_frame(const context& context, const synchron& sync, uint64_t frame_number)
+{
+	wait_timeline(context, sync.graphics, frame_number);
 }
@@ -0,0 +1,90 @@
+#include "polymorph/vulkan/context.h"
+
+#include <algorithm>
+
+using namespace poly::vk;
+
+// ------------------------- UTILS -------------------------
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// ------------------------- FRAME ALLOCATOR -------------------------
+
+void poly::vk::create_frame_allocator(const context& context, frame_allocator& allocator, VkDeviceSize capacity, uint32_t frame_count)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(context.device.v_physical, &properties);
+
+    allocator.uniform_alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+    allocator.storage_alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 16);
+
+    allocator.buffers.resize(frame_count);
+    for (auto& buf : allocator.buffers)
+    {
+        create_mapped_buffer(context, buf, capacity,
+                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        tag_buffer(context, buf, memory_category::transient, "frame allocator");
+    }
+
+    allocator.capacity = capacity;
+    allocator.head = 0;
+    allocator.frame = 0;
+}
+
+void poly::vk::destroy_frame_allocator(const context& context, frame_allocator& allocator)
+{
+    for (auto& buf : allocator.buffers)
+    {
+        destroy_buffer(context, buf);
+    }
+    allocator.buffers.clear();
+    allocator.capacity = 0;
+    allocator.head = 0;
+}
+
+void poly::vk::reset_frame_allocator(frame_allocator& allocator, uint32_t frame)
+{
+    allocator.frame = frame % static_cast<uint32_t>(allocator.buffers.size());
+    allocator.head = 0;
+}
+
+transient_allocation poly::vk::allocate_transient(frame_allocator& allocator, VkDeviceSize size, transient_usage usage)
+{
+    VkDeviceSize alignment = 4; // Index buffer offsets must be a multiple of the index size.
+    switch (usage)
+    {
+    case transient_usage::uniform: alignment = allocator.uniform_alignment; break;
+    case transient_usage::storage: alignment = allocator.storage_alignment; break;
+    case transient_usage::vertex:  alignment = 16; break;
+    case transient_usage::index:   alignment = 4; break;
+    }
+
+    VkDeviceSize offset = align_up(allocator.head, alignment);
+    if (offset + size > allocator.capacity)
+    {
+        THROW_VK("frame allocator is out of memory");
+    }
+    allocator.head = offset + size;
+
+    const buffer& buf = allocator.buffers[allocator.frame];
+
+    transient_allocation allocation{};
+    allocation.buffer = buf.value;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.mapped = static_cast<uint8_t*>(buf.mapped) + offset;
+    return allocation;
+}
+
+void poly::vk::flush_frame_allocator(const context& context, const frame_allocator& allocator)
+{
+    if (allocator.head > 0)
+    {
+        const buffer& buf = allocator.buffers[allocator.frame];
+        CHECK_VK(vmaFlushAllocation(context.allocator, buf.allocation, 0, allocator.head)); // No-op for coherent memory.
+    }
+}
@@ -0,0 +1,567 @@
+#include "polymorph/vulkan/context.h"
+#include "polymorph/vulkan/defines.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace poly::vk;
+
+// Every stage an uploaded resource may be read from once it reaches the graphics queue.
+static constexpr VkPipelineStageFlags UPLOAD_CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+static constexpr VkAccessFlags UPLOAD_CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+// ------------------------- UTILS -------------------------
+
+// Alignments need not be powers of two, as image uploads align to their texel block size.
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Images left ready for mip generation are read by blits, everything else by shaders.
+static VkAccessFlags image_consumer_access(VkImageLayout layout)
+{
+    return layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+}
+
+static void record_mip_generation(VkCommandBuffer cmd, const mip_generation& gen)
+{
+    VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = gen.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = gen.array_layers;
+
+    // Every level below the top is written by a blit, so its previous contents are discarded.
+    if (gen.mip_levels > 1)
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.subresourceRange.baseMipLevel = 1;
+        barrier.subresourceRange.levelCount = gen.mip_levels - 1;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+    }
+
+    barrier.subresourceRange.levelCount = 1;
+    VkExtent3D extent = gen.extent;
+    for (uint32_t level = 1; level < gen.mip_levels; level++)
+    {
+        VkExtent3D next = { std::max(1u, extent.width >> 1), std::max(1u, extent.height >> 1), std::max(1u, extent.depth >> 1) };
+
+        VkImageBlit blit{};
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, gen.array_layers };
+        blit.srcOffsets[1] = { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), static_cast<int32_t>(extent.depth) };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, gen.array_layers };
+        blit.dstOffsets[1] = { static_cast<int32_t>(next.width), static_cast<int32_t>(next.height), static_cast<int32_t>(next.depth) };
+        vkCmdBlitImage(cmd, gen.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, gen.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, gen.filter);
+
+        // The level just written is the source of the next.
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.subresourceRange.baseMipLevel = level;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+
+        extent = next;
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = gen.final_layout;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = gen.mip_levels;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, UPLOAD_CONSUMER_STAGES, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+}
+
+static upload_batch* oldest_batch(upload_manager& uploads, upload_batch_state state)
+{
+    upload_batch* oldest = nullptr;
+    for (auto& batch : uploads.batches)
+    {
+        if (batch.state == state && (oldest == nullptr || batch.id < oldest->id))
+        {
+            oldest = &batch;
+        }
+    }
+    return oldest;
+}
+
+// Retires every batch whose transfers have finished, oldest first, releasing their staging space.
+static void retire_batches(const context& context, upload_manager& uploads, bool wait_oldest)
+{
+    while (upload_batch* oldest = oldest_batch(uploads, upload_batch_state::in_flight))
+    {
+        if (!wait_timeline(context, uploads.transfer, oldest->id, wait_oldest ? UINT64_MAX : 0))
+        {
+            break;
+        }
+        wait_oldest = false;
+
+        uploads.tail = oldest->ring_end;
+        if (uploads.ownership_transfer)
+        {
+            oldest->state = upload_batch_state::transferred;
+        }
+        else
+        {
+            oldest->state = upload_batch_state::idle;
+            uploads.completed_id = oldest->id;
+        }
+    }
+}
+
+// Retires every handed off batch whose acquire, and the mip generation recorded with it, has finished on the graphics queue.
+static void retire_handoffs(const context& context, upload_manager& uploads, bool wait_oldest)
+{
+    while (upload_batch* oldest = oldest_batch(uploads, upload_batch_state::handed_off))
+    {
+        VkResult result = vkWaitForFences(context.device.v_logical, 1, &oldest->v_acquire_fence, VK_TRUE, wait_oldest ? UINT64_MAX : 0);
+        if (result == VK_TIMEOUT)
+        {
+            break;
+        }
+        CHECK_VK(result);
+        wait_oldest = false;
+
+        // Batches are handed off in id order, so every older batch has completed too.
+        oldest->state = upload_batch_state::idle;
+        uploads.completed_id = oldest->id;
+    }
+}
+
+// Tickets for a batch with nothing recorded in it have nothing to wait for.
+static uint64_t effective_ticket(const upload_manager& uploads, upload_ticket ticket)
+{
+    const upload_batch& current = uploads.batches[uploads.current];
+    return (ticket.value == current.id && current.state != upload_batch_state::recording) ? current.id - 1 : ticket.value;
+}
+
+static upload_batch& recording_batch(const context& context, upload_manager& uploads)
+{
+    upload_batch& batch = uploads.batches[uploads.current];
+    if (batch.state != upload_batch_state::recording)
+    {
+        VkCommandBufferBeginInfo info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        CHECK_VK(vkBeginCommandBuffer(batch.v_cmd, &info));
+        batch.buffer_releases.clear();
+        batch.image_releases.clear();
+        batch.mip_generations.clear();
+        batch.state = upload_batch_state::recording;
+    }
+    return batch;
+}
+
+static void submit_batch(const context& context, upload_manager& uploads)
+{
+    upload_batch& batch = uploads.batches[uploads.current];
+
+    if (uploads.ownership_transfer)
+    {
+        // Release half of the queue family ownership transfer, mirrored by the acquire in submit_upload_handoffs.
+        vkCmdPipelineBarrier(batch.v_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, VK_NULL_HANDLE,
+                             static_cast<uint32_t>(batch.buffer_releases.size()), batch.buffer_releases.data(),
+                             static_cast<uint32_t>(batch.image_releases.size()), batch.image_releases.data());
+    }
+    else
+    {
+        // Make the transfers visible to any later reads on the queue, and move images into their final layouts.
+        VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+        vkCmdPipelineBarrier(batch.v_cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, UPLOAD_CONSUMER_STAGES, 0,
+                             1, &barrier,
+                             0, VK_NULL_HANDLE,
+                             static_cast<uint32_t>(batch.image_releases.size()), batch.image_releases.data());
+
+        // The transfer queue shares the graphics family here, so it can blit.
+        for (const auto& gen : batch.mip_generations)
+        {
+            record_mip_generation(batch.v_cmd, gen);
+        }
+    }
+
+    CHECK_VK(vkEndCommandBuffer(batch.v_cmd));
+
+    // Batch ids only increase, so they double as the values of the transfer timeline.
+    VkSemaphore signal_semaphores[2] = { uploads.transfer.v_semaphore, batch.v_transferred };
+    uint64_t signal_values[2] = { next_timeline_value(uploads.transfer, batch.id), 0 };
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timeline_info.signalSemaphoreValueCount = uploads.ownership_transfer ? 2 : 1;
+    timeline_info.pSignalSemaphoreValues = signal_values;
+
+    VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.pNext = &timeline_info;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.v_cmd;
+    submit_info.signalSemaphoreCount = timeline_info.signalSemaphoreValueCount;
+    submit_info.pSignalSemaphores = signal_semaphores;
+
+    CHECK_VK(vkQueueSubmit(context.device.v_transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+
+    batch.ring_end = uploads.head;
+    batch.state = upload_batch_state::in_flight;
+
+    // Move on to the next batch, waiting for it if it is still in use.
+    uploads.current = (uploads.current + 1) % static_cast<uint32_t>(uploads.batches.size());
+    upload_batch& next = uploads.batches[uploads.current];
+    while (next.state == upload_batch_state::in_flight || next.state == upload_batch_state::transferred)
+    {
+        retire_batches(context, uploads, true);
+        submit_upload_handoffs(context, uploads);
+    }
+    while (next.state == upload_batch_state::handed_off)
+    {
+        retire_handoffs(context, uploads, true);
+    }
+    next.id = uploads.next_id++;
+}
+
+// Reserves ring space for the current batch, retiring or flushing batches until enough is free.
+static VkDeviceSize reserve_staging(const context& context, upload_manager& uploads, VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize phys = uploads.head % uploads.capacity;
+    VkDeviceSize pad = align_up(phys, alignment) - phys;
+    if (phys + pad + size > uploads.capacity) // Skip the remainder of the ring and wrap to the start.
+    {
+        pad = uploads.capacity - phys;
+    }
+
+    while (uploads.head + pad + size - uploads.tail > uploads.capacity)
+    {
+        if (oldest_batch(uploads, upload_batch_state::in_flight) != nullptr)
+        {
+            retire_batches(context, uploads, true);
+        }
+        else
+        {
+            submit_batch(context, uploads);
+        }
+    }
+
+    VkDeviceSize offset = (uploads.head + pad) % uploads.capacity;
+    uploads.head += pad + size;
+    return offset;
+}
+
+// ------------------------- UPLOAD MANAGER -------------------------
+
+void poly::vk::create_upload_manager(const context& context, upload_manager& uploads, VkDeviceSize capacity)
+{
+    uploads.ownership_transfer = context.device.transfer_queue_index != context.device.graphics_queue_index;
+
+    VkCommandPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = context.device.transfer_queue_index;
+    CHECK_VK(vkCreateCommandPool(context.device.v_logical, &pool_info, VK_NULL_HANDLE, &uploads.v_command_pool));
+
+    pool_info.queueFamilyIndex = context.device.graphics_queue_index;
+    CHECK_VK(vkCreateCommandPool(context.device.v_logical, &pool_info, VK_NULL_HANDLE, &uploads.v_acquire_command_pool));
+
+    create_mapped_buffer(context, uploads.staging, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    tag_buffer(context, uploads.staging, memory_category::staging, "staging ring");
+    uploads.capacity = capacity;
+    uploads.head = 0;
+    uploads.tail = 0;
+
+    create_queue_timeline(context, uploads.transfer);
+    uploads.batches.resize(VULKAN_UPLOAD_BATCH_COUNT);
+
+    VkCommandBufferAllocateInfo cmd_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_info.commandBufferCount = 1;
+
+    VkFenceCreateInfo fence_info{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    VkSemaphoreCreateInfo semaphore_info{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+
+    for (auto& batch : uploads.batches)
+    {
+        cmd_info.commandPool = uploads.v_command_pool;
+        CHECK_VK(vkAllocateCommandBuffers(context.device.v_logical, &cmd_info, &batch.v_cmd));
+        cmd_info.commandPool = uploads.v_acquire_command_pool;
+        CHECK_VK(vkAllocateCommandBuffers(context.device.v_logical, &cmd_info, &batch.v_acquire_cmd));
+
+        CHECK_VK(vkCreateFence(context.device.v_logical, &fence_info, VK_NULL_HANDLE, &batch.v_acquire_fence));
+        CHECK_VK(vkCreateSemaphore(context.device.v_logical, &semaphore_info, VK_NULL_HANDLE, &batch.v_transferred));
+
+        batch.id = 0;
+        batch.ring_end = 0;
+        batch.state = upload_batch_state::idle;
+    }
+
+    uploads.current = 0;
+    uploads.completed_id = 0;
+    uploads.batches[0].id = 1;
+    uploads.next_id = 2;
+}
+
+void poly::vk::destroy_upload_manager(const context& context, upload_manager& uploads)
+{
+    wait_timeline(context, uploads.transfer, uploads.transfer.submitted);
+    for (auto& batch : uploads.batches)
+    {
+        vkWaitForFences(context.device.v_logical, 1, &batch.v_acquire_fence, VK_TRUE, UINT64_MAX);
+        if (batch.state == upload_batch_state::recording)
+        {
+            vkEndCommandBuffer(batch.v_cmd);
+        }
+        vkDestroyFence(context.device.v_logical, batch.v_acquire_fence, VK_NULL_HANDLE);
+        vkDestroySemaphore(context.device.v_logical, batch.v_transferred, VK_NULL_HANDLE);
+    }
+    uploads.batches.clear();
+    destroy_queue_timeline(context, uploads.transfer);
+
+    vkDestroyCommandPool(context.device.v_logical, uploads.v_command_pool, VK_NULL_HANDLE);
+    uploads.v_command_pool = VK_NULL_HANDLE;
+    vkDestroyCommandPool(context.device.v_logical, uploads.v_acquire_command_pool, VK_NULL_HANDLE);
+    uploads.v_acquire_command_pool = VK_NULL_HANDLE;
+
+    destroy_buffer(context, uploads.staging);
+}
+
+// ------------------------- UPLOAD -------------------------
+
+upload_ticket poly::vk::enqueue_buffer_upload(const context& context, upload_manager& uploads, const buffer& dst, VkDeviceSize dst_offset, VkDeviceSize size, const void* data)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    const VkDeviceSize max_chunk = uploads.capacity / 4;
+
+    while (size > 0)
+    {
+        VkDeviceSize chunk = std::min(size, max_chunk);
+        VkDeviceSize offset = reserve_staging(context, uploads, chunk, 16);
+        write_buffer(context, uploads.staging, src, offset, chunk);
+
+        upload_batch& batch = recording_batch(context, uploads);
+
+        VkBufferCopy region{};
+        region.srcOffset = offset;
+        region.dstOffset = dst_offset;
+        region.size = chunk;
+        vkCmdCopyBuffer(batch.v_cmd, uploads.staging.value, dst.value, 1, &region);
+
+        if (uploads.ownership_transfer)
+        {
+            VkBufferMemoryBarrier release{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.dstAccessMask = 0;
+            release.srcQueueFamilyIndex = context.device.transfer_queue_index;
+            release.dstQueueFamilyIndex = context.device.graphics_queue_index;
+            release.buffer = dst.value;
+            release.offset = dst_offset;
+            release.size = chunk;
+            batch.buffer_releases.push_back(release);
+        }
+
+        src += chunk;
+        dst_offset += chunk;
+        size -= chunk;
+    }
+
+    return upload_ticket{ uploads.batches[uploads.current].id };
+}
+
+upload_ticket poly::vk::enqueue_image_upload(const context& context, upload_manager& uploads, image& dst, const VkImageSubresourceLayers& subresource, const VkExtent3D& extent, VkImageLayout final_layout, VkDeviceSize size, const void* data)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    const VkDeviceSize max_chunk = uploads.capacity / 4;
+
+    // Rows are copied a row of texel blocks at a time, which is a single row of texels for uncompressed formats.
+    const format_block block = get_format_block(dst.format);
+    if (block.bytes == 0)
+    {
+        THROW_VK("Image upload of a format with an unknown texel block size");
+    }
+    const VkDeviceSize row_pitch = static_cast<VkDeviceSize>((extent.width + block.width - 1) / block.width) * block.bytes;
+    const uint32_t block_rows = (extent.height + block.height - 1) / block.height;
+    if (row_pitch == 0 || size != row_pitch * block_rows * extent.depth * subresource.layerCount)
+    {
+        THROW_VK("Image upload size does not match its extent, layers and format");
+    }
+    const uint32_t max_rows = static_cast<uint32_t>(std::max<VkDeviceSize>(1, max_chunk / row_pitch)) * block.height;
+    const VkDeviceSize alignment = std::lcm<VkDeviceSize>(16, block.bytes);
+
+    VkImageSubresourceRange range{};
+    range.aspectMask = subresource.aspectMask;
+    range.baseMipLevel = subresource.mipLevel;
+    range.levelCount = 1;
+    range.baseArrayLayer = subresource.baseArrayLayer;
+    range.layerCount = subresource.layerCount;
+
+    // Batches run in order on the same queue, so the image stays with the transfer family in TRANSFER_DST_OPTIMAL even if it is split over several of them.
+    VkImageMemoryBarrier to_transfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    to_transfer.srcAccessMask = 0;
+    to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_transfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.image = dst.v_image;
+    to_transfer.subresourceRange = range;
+    vkCmdPipelineBarrier(recording_batch(context, uploads).v_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &to_transfer);
+
+    // Uploads larger than a chunk are split into bands of rows, one layer and depth slice at a time.
+    for (uint32_t layer = 0; layer < subresource.layerCount; layer++)
+    {
+        for (uint32_t z = 0; z < extent.depth; z++)
+        {
+            for (uint32_t y = 0; y < extent.height; )
+            {
+                uint32_t rows = std::min(extent.height - y, max_rows);
+                VkDeviceSize chunk = static_cast<VkDeviceSize>((rows + block.height - 1) / block.height) * row_pitch;
+                VkDeviceSize offset = reserve_staging(context, uploads, chunk, alignment);
+                write_buffer(context, uploads.staging, src, offset, chunk);
+
+                VkBufferImageCopy region{};
+                region.bufferOffset = offset;
+                region.bufferRowLength = 0;
+                region.bufferImageHeight = 0;
+                region.imageSubresource = subresource;
+                region.imageSubresource.baseArrayLayer = subresource.baseArrayLayer + layer;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = { 0, static_cast<int32_t>(y), static_cast<int32_t>(z) };
+                region.imageExtent = { extent.width, rows, 1 };
+                vkCmdCopyBufferToImage(recording_batch(context, uploads).v_cmd, uploads.staging.value, dst.v_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+                src += chunk;
+                y += rows;
+            }
+        }
+    }
+
+    // Released by the batch holding the last band.
+    VkImageMemoryBarrier release{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    release.dstAccessMask = uploads.ownership_transfer ? 0 : image_consumer_access(final_layout);
+    release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    release.newLayout = final_layout;
+    release.srcQueueFamilyIndex = uploads.ownership_transfer ? context.device.transfer_queue_index : VK_QUEUE_FAMILY_IGNORED;
+    release.dstQueueFamilyIndex = uploads.ownership_transfer ? context.device.graphics_queue_index : VK_QUEUE_FAMILY_IGNORED;
+    release.image = dst.v_image;
+    release.subresourceRange = range;
+    recording_batch(context, uploads).image_releases.push_back(release);
+
+    // The upload hands the image over already synchronised, so reads need no further barrier.
+    dst.state = { final_layout, 0, 0, 0, 0 };
+    return upload_ticket{ uploads.batches[uploads.current].id };
+}
+
+upload_ticket poly::vk::enqueue_mip_generation(const context& context, upload_manager& uploads, image& img, VkImageLayout final_layout)
+{
+    if (img.mip_levels > 1 && !supports_mip_generation(context, img.format))
+    {
+        THROW_VK("Mip generation of a format that cannot be blitted");
+    }
+
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(context.device.v_physical, img.format, &properties);
+
+    mip_generation gen{};
+    gen.image = img.v_image;
+    gen.extent = img.extent;
+    gen.mip_levels = img.mip_levels;
+    gen.array_layers = img.array_layers;
+    gen.filter = properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    gen.final_layout = final_layout;
+
+    // Kept with the batch holding the release of the top level, so it runs straight after the acquire.
+    recording_batch(context, uploads).mip_generations.push_back(gen);
+
+    img.state = { final_layout, 0, 0, 0, 0 };
+    return upload_ticket{ uploads.batches[uploads.current].id };
+}
+
+upload_ticket poly::vk::flush_uploads(const context& context, upload_manager& uploads)
+{
+    if (uploads.batches[uploads.current].state == upload_batch_state::recording)
+    {
+        submit_batch(context, uploads);
+    }
+    return upload_ticket{ uploads.next_id - 2 }; // The id of the most recently submitted batch.
+}
+
+void poly::vk::submit_upload_handoffs(const context& context, upload_manager& uploads)
+{
+    retire_batches(context, uploads, false);
+
+    while (upload_batch* batch = oldest_batch(uploads, upload_batch_state::transferred))
+    {
+        // Acquire half of the queue family ownership transfer, mirroring the release barriers.
+        for (auto& barrier : batch->buffer_releases)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+        }
+        for (auto& barrier : batch->image_releases)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = image_consumer_access(barrier.newLayout);
+        }
+
+        VkCommandBufferBeginInfo info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        CHECK_VK(vkBeginCommandBuffer(batch->v_acquire_cmd, &info));
+        vkCmdPipelineBarrier(batch->v_acquire_cmd, UPLOAD_CONSUMER_STAGES, UPLOAD_CONSUMER_STAGES, 0,
+                             0, VK_NULL_HANDLE,
+                             static_cast<uint32_t>(batch->buffer_releases.size()), batch->buffer_releases.data(),
+                             static_cast<uint32_t>(batch->image_releases.size()), batch->image_releases.data());
+        for (const auto& gen : batch->mip_generations)
+        {
+            record_mip_generation(batch->v_acquire_cmd, gen);
+        }
+        CHECK_VK(vkEndCommandBuffer(batch->v_acquire_cmd));
+
+        // The transfers have finished, so this wait is already satisfied and never stalls the graphics queue.
+        VkPipelineStageFlags wait_stage = UPLOAD_CONSUMER_STAGES;
+        VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &batch->v_transferred;
+        submit_info.pWaitDstStageMask = &wait_stage;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch->v_acquire_cmd;
+
+        CHECK_VK(vkResetFences(context.device.v_logical, 1, &batch->v_acquire_fence));
+        CHECK_VK(vkQueueSubmit(context.device.v_graphics_queue, 1, &submit_info, batch->v_acquire_fence));
+
+        batch->state = upload_batch_state::handed_off;
+    }
+    retire_handoffs(context, uploads, false);
+}
+
+bool poly::vk::is_upload_complete(const context& context, upload_manager& uploads, upload_ticket ticket)
+{
+    uint64_t value = effective_ticket(uploads, ticket);
+    if (value <= uploads.completed_id)
+    {
+        return true;
+    }
+    submit_upload_handoffs(context, uploads);
+    return value <= uploads.completed_id;
+}
+
+void poly::vk::wait_for_upload(const context& context, upload_manager& uploads, upload_ticket ticket)
+{
+    if (ticket.value == uploads.batches[uploads.current].id)
+    {
+        flush_uploads(context, uploads);
+    }
+
+    uint64_t value = effective_ticket(uploads, ticket);
+    while (value > uploads.completed_id)
+    {
+        retire_batches(context, uploads, true);
+        submit_upload_handoffs(context, uploads);
+        retire_handoffs(context, uploads, true);
+    }
+}
@@ -60,6 +60,28 @@ poly::vk::queue_families poly::vk::get_queue_families(VkPhysicalDevice device, V
             break;
         }
     }
+
+    // Prefer a transfer-only family, which maps to the dedicated copy engines on most discrete GPUs.
+    for(uint32_t i = 0; i < qf_properties.size(); i++)
+    {
+        VkQueueFlags flags = qf_properties[i].queueFlags;
+        if((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            qf.transfer = i;
+            break;
+        }
+    }
+
+    // Prefer a compute family without graphics, so async compute runs alongside rasterisation rather than queued behind it.
+    for(uint32_t i = 0; i < qf_properties.size(); i++)
+    {
+        VkQueueFlags flags = qf_properties[i].queueFlags;
+        if((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            qf.compute = i;
+            break;
+        }
+    }
     return qf;
 }
 
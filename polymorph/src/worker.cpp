@@ -0,0 +1,105 @@
+#include "polymorph/worker.h"
+
+using namespace poly;
+
+// ------------------------- UTILS -------------------------
+
+static void drain(worker_pool& pool, uint32_t thread)
+{
+    uint32_t job;
+    while ((job = pool.next.fetch_add(1)) < pool.job_count)
+    {
+        pool.job(pool.job_data, job, thread);
+        if (pool.remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.done.notify_all();
+        }
+    }
+}
+
+static void worker_main(worker_pool* pool, uint32_t thread)
+{
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->wake.wait(lock, [&]() { return pool->stop || pool->generation != seen; });
+            if (pool->stop)
+            {
+                return;
+            }
+            seen = pool->generation;
+            pool->active++;
+        }
+
+        drain(*pool, thread);
+
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->active--;
+        pool->done.notify_all();
+    }
+}
+
+// ------------------------- WORKER POOL -------------------------
+
+void poly::create_worker_pool(worker_pool& pool, uint32_t thread_count)
+{
+    pool.thread_count = thread_count > 0 ? thread_count : 1;
+    pool.job = nullptr;
+    pool.job_data = nullptr;
+    pool.job_count = 0;
+    pool.next = 0;
+    pool.remaining = 0;
+    pool.active = 0;
+    pool.generation = 0;
+    pool.stop = false;
+
+    for (uint32_t thread = 1; thread < pool.thread_count; thread++)
+    {
+        pool.threads.emplace_back(worker_main, &pool, thread);
+    }
+}
+
+void poly::destroy_worker_pool(worker_pool& pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stop = true;
+    }
+    pool.wake.notify_all();
+
+    for (auto& thread : pool.threads)
+    {
+        thread.join();
+    }
+    pool.threads.clear();
+}
+
+void poly::dispatch_jobs(worker_pool& pool, uint32_t job_count, worker_job job, void* data)
+{
+    if (job_count == 0)
+    {
+        return;
+    }
+
+    {
+        // Workers that woke late for the last dispatch must be out of it before its state is replaced.
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        pool.done.wait(lock, [&]() { return pool.active == 0; });
+
+        pool.job = job;
+        pool.job_data = data;
+        pool.job_count = job_count;
+        pool.next = 0;
+        pool.remaining = job_count;
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+
+    drain(pool, 0);
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&]() { return pool.remaining == 0 && pool.active == 0; });
+}